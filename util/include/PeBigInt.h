@@ -6,19 +6,27 @@
 
 #pragma once
 
+#include "PeBigIntDigits.h"
 #include "PeDefinitions.h"
+#include "PeLimbArithmetic.h"
+#include "PeLimbPool.h"
+#include "PeSmallVector.h"
 #include "PeUtilities.h"
 
 #include <algorithm>
+#include <array>
 #include <iomanip>
 #include <iostream>
-#include <regex>
 #include <sstream>
 #include <string>
 #include <vector>
 
 namespace pe
 {
+// Expression templates, see PeBigIntExpr.h
+template <typename E>
+class PeBigIntExpr;
+class PeBigIntAccumulator;
 
 // A simple arbitrary precision unsigned integer class
 // supporting addition, subtraction, multiplication and integer division
@@ -46,7 +54,7 @@ public:
     PeBigInt(long double val);
 
     // String constructors
-    // These take a positive, numeric integer string.
+    // These take a numeric integer string with an optional sign.
     // Decimals aren't supported.
     // Exponent notation supported if strictly of the form:
     //	x...x[e|E]p...p
@@ -54,18 +62,25 @@ public:
     //  1234e121
     //  1e1000
     //  653E001
-    //  75357E010
+    //  -75357E010
     //
-    // Note: no sign symbol, no decimals, no negative exponents, no whitespace
+    // Note: no decimals, no negative exponents, no whitespace
     PeBigInt(const char* valstr);
     PeBigInt(const std::string& valstr);
 
+    // Evaluate an arithmetic expression, see PeBigIntExpr.h
+    template <typename E>
+    PeBigInt(const PeBigIntExpr<E>& expr);
+
     virtual ~PeBigInt();
 
     // Copy and move assignment operator
     PeBigInt& operator=(const PeBigInt& rhs);
     PeBigInt& operator=(PeBigInt&& rhs) noexcept;
 
+    template <typename E>
+    PeBigInt& operator=(const PeBigIntExpr<E>& expr);
+
     // Unary operators
     PeBigInt operator-() const;
 
@@ -82,30 +97,22 @@ public:
     PeBigInt& operator-=(const PeBigInt& rhs);
     PeBigInt& operator*=(const PeBigInt& rhs);
     PeBigInt& operator/=(const PeBigInt& rhs);
+    PeBigInt& operator%=(const PeBigInt& rhs);
 
+    // Binary +, - and * build lazily evaluated expressions and are declared
+    // in PeBigIntExpr.h.
+    //
     // Friends defined inside class body are inline and are hidden from non-ADL
-    // lookup Passing lhs by value helps optimise chains like a+b+c
-    friend inline PeBigInt operator+(PeBigInt lhs, const PeBigInt& rhs)
-    {
-        lhs += rhs; // Reuse compound assignment
-        return lhs; // Return the result by value (uses move constructor)
-    }
-
-    friend inline PeBigInt operator-(PeBigInt lhs, const PeBigInt& rhs)
-    {
-        lhs -= rhs;
-        return lhs;
-    }
-
-    friend inline PeBigInt operator*(PeBigInt lhs, const PeBigInt& rhs)
+    // lookup Passing lhs by value helps optimise chains like a/b/c
+    friend inline PeBigInt operator/(PeBigInt lhs, const PeBigInt& rhs)
     {
-        lhs *= rhs;
+        lhs /= rhs;
         return lhs;
     }
 
-    friend inline PeBigInt operator/(PeBigInt lhs, const PeBigInt& rhs)
+    friend inline PeBigInt operator%(PeBigInt lhs, const PeBigInt& rhs)
     {
-        lhs /= rhs;
+        lhs %= rhs;
         return lhs;
     }
 
@@ -127,25 +134,140 @@ public:
     // Conversion to string
     operator std::string() const;
 
+    // Write the decimal representation (with a leading '-' if negative)
+    // to a caller supplied buffer, without any intermediate allocation.
+    // No null terminator is written. Returns the number of characters
+    // written, which is at most toCharsSize().
+    size_t toChars(char* buffer) const;
+    size_t toCharsSize() const;
+
     // Convenience zero test
     bool isZero() const;
 
-    // Raise number to the power n
-    PeBigInt& PeBigInt::power(PeUint exponent);
-
-    // Radix shift, analogous to << and >> for binary
+    // Divide this number by rhs, leaving the quotient in this number and
+    // storing the remainder in <remainder>. This is cheaper than using
+    // operator/ and operator% separately.
+    // As with built in integers, the quotient is truncated towards zero
+    // and the remainder takes the sign of the dividend.
+    // Throws runtime_error if rhs is zero.
+    PeBigInt& divmod(const PeBigInt& rhs, PeBigInt& remainder);
+
+    // Arithmetic with a small signed operand. For operands below kBase
+    // (10^8) in absolute value these work in place in a single pass over the
+    // limbs, and only allocate if the number outgrows its storage. Larger
+    // operands fall back to the general operators.
+
+    // Multiply this number by k
+    PeBigInt& mulSmall(PeInt k);
+
+    // Add k to this number
+    PeBigInt& addSmall(PeInt k);
+
+    // Fused multiply-add: add x * k to this number. x may be this number.
+    PeBigInt& fma(const PeBigInt& x, PeInt k);
+
+    // Divide this number by d, returning the remainder. As with divmod(),
+    // the quotient is truncated towards zero and the remainder takes the
+    // sign of the dividend. Throws runtime_error if d is zero.
+    PeInt divSmall(PeInt d);
+
+    // Raise number to the power n (with 0^0 taken as 1).
+    // Powers of ten, including powers of kBase, are formed by a radix shift
+    // without any multiplication. Other numbers use sliding window
+    // exponentiation with squaring.
+    PeBigInt& power(PeUint exponent);
+
+    // Integer roots by Newton's iteration. The root is truncated towards
+    // zero, and the versions taking <remainder> also store n - root^k there.
+    // Large numbers first find the root of their leading limbs, so each
+    // Newton iteration starts from about half the final precision, and the
+    // smallest roots start from a long double estimate.
+
+    // floor(sqrt(n)). Throws runtime_error if this number is negative.
+    PeBigInt isqrt() const;
+    PeBigInt isqrt(PeBigInt& remainder) const;
+
+    // The k-th root for k >= 1. Negative numbers have odd roots only.
+    // Throws runtime_error for k = 0 or an even root of a negative number.
+    PeBigInt iroot(PeUint k) const;
+    PeBigInt iroot(PeUint k, PeBigInt& remainder) const;
+
+    // Test whether this number is b^k for integers b and k >= 2 (0, 1 and -1
+    // count). The second version stores the b with the largest k.
+    bool isPerfectPower() const;
+    bool isPerfectPower(PeBigInt& base, PeUint& exponent) const;
+
+    // Radix shift, analogous to << and >> for binary.
+    // Shifts only change the count of zero limbs kept below the stored
+    // limbs, so left shifts, and right shifts of no more than earlier left
+    // shifts, take constant time. Larger right shifts drop stored limbs.
     PeBigInt& radixShift(PeInt n);
 
     // Reverse this number's digits
     PeBigInt& reverseDigits();
 
-    // Square this number i.e. n = n * n
+    // Square this number i.e. n = n * n, so the result is never negative
     // Used as a helper function for power()
-    PeBigInt& PeBigInt::square();
+    PeBigInt& square();
 
-    // Return the sum of this number's digits (ignores sign)
+    // Return the sum of this number's digits (ignores sign).
+    // digitSum() is cheaper, this is kept for existing callers.
     PeBigInt sumDigits();
 
+    // Decimal digit queries, all ignoring sign and working straight from
+    // the limbs rather than converting to a string.
+
+    // The sum of the decimal digits, which always fits in a PeUint
+    PeUint digitSum() const;
+
+    // The number of decimal digits (1 for zero)
+    size_t numDigits() const;
+
+    // The decimal digits, see PeBigIntDigits.h
+    PeBigIntDigits digits() const;
+
+    // How many times each decimal digit 0-9 appears
+    std::array<PeUint, 10> digitHistogram() const;
+
+    // Products of many factors. These multiply by balanced binary splitting
+    // (a product tree), so the large multiplications have operands of
+    // similar sizes, rather than multiplying in one factor at a time which
+    // costs O(n^2) limb operations for an n limb result.
+
+    // n!, built from its prime factorisation: each prime's exponent comes
+    // from Legendre's formula and primes are grouped by exponent bit, so the
+    // result is a few products of primes joined by squarings.
+    static PeBigInt Factorial(PeUint n);
+
+    // The product of all primes no greater than n
+    static PeBigInt PrimorialUpTo(PeUint n);
+
+    // The product of the integers first to last inclusive (1 if last < first)
+    static PeBigInt ProductOf(PeUint first, PeUint last);
+
+    // The product of a list of factors (1 if the list is empty)
+    static PeBigInt ProductOf(const std::vector<PeUint>& factors);
+    static PeBigInt ProductOf(const std::vector<PeBigInt>& factors);
+
+    // Greatest common divisors by Lehmer's algorithm. Each step runs
+    // Euclid's algorithm on the leading limbs of both numbers alone, then
+    // applies the combined quotients to the full numbers with single limb
+    // multiplications, so most quotients never need a long division. GCDs
+    // finish with a binary GCD once the numbers fit in two limbs. Signs are
+    // ignored and gcd(0, 0) is 0.
+    static PeBigInt Gcd(const PeBigInt& a, const PeBigInt& b);
+
+    // Lowest common multiple, always non-negative (0 if either number is 0)
+    static PeBigInt Lcm(const PeBigInt& a, const PeBigInt& b);
+
+    // gcd(a, b), also storing x and y such that a * x + b * y = gcd(a, b).
+    // x and y may be a or b.
+    static PeBigInt ExtendedGcd(const PeBigInt& a, const PeBigInt& b, PeBigInt& x, PeBigInt& y);
+
+    // The inverse of a modulo m, in the range [0, m).
+    // Throws runtime_error if m isn't positive or a and m aren't coprime.
+    static PeBigInt ModInverse(const PeBigInt& a, const PeBigInt& m);
+
     // Private helper functions
 private:
     // Initialiser functions
@@ -166,33 +288,71 @@ private:
     PeBigInt& absPlusEq(const PeBigInt& rhs);
     PeBigInt& absMinusEq(const PeBigInt& rhs);
     PeBigInt& absMultEq(const PeBigInt& rhs);
-
-    // Warning: Horrifically slow. Only really here for a sense of completeness.
     PeBigInt& absDivEq(const PeBigInt& rhs);
 
-    // Divide by a denominator less than kBase.
+    // Divide absolute values, optionally storing the absolute value
+    // of the remainder (if remainder is not null)
+    PeBigInt& absDivModEq(const PeBigInt& rhs, PeBigInt* remainder);
+
+    // Divide by a denominator less than kBase, returning the remainder.
     // Note that denominator is not checked against kBase;
     // dividing by a denominator greater than kBase is undefined.
-    PeBigInt& absShortDivEq(PeInt denominator);
+    PeUint absShortDivEq(PeUint denominator);
+
+    // Lehmer's algorithm on a >= b >= 0, leaving gcd(a, b) in a and zero
+    // in b. If <u> is given, <u> and <v> are updated alongside a and b by
+    // the same steps, so any linear relation between the starting values
+    // of (a, u) and (b, v) holds for the final a and u.
+    static void lehmerGcd(PeBigInt& a, PeBigInt& b, PeBigInt* u, PeBigInt* v);
 
     // Utility
 
     // Remove any leading zeros
     void popLeadingZeros();
 
+    // Remove any leading zeros, keeping at least one limb,
+    // and give zero a positive sign
+    void normalise();
+
+    // Store <offset> of the implicit low zero limbs (offset <= offset_) as
+    // real limbs, so that offset_ becomes <offset>. Code that works on the
+    // limbs without handling offsets calls this with zero first.
+    void reduceOffset(size_t offset);
+
+    // The magnitude as a PeUint, for values already known to fit
+    PeUint absToUnsigned() const;
+
+    // Limb storage. Values of up to kInlineLimbs limbs (32 decimal digits)
+    // are held inside the object itself, so the small temporaries that most
+    // arithmetic produces never touch the heap. Larger values draw their
+    // blocks from the current thread's PeLimbPool.
+    static const size_t kInlineLimbs = 4;
+    typedef PeSmallVector<PeUint, kInlineLimbs, PeLimbPoolAllocator> LimbVector;
+
+    // Expression evaluation works directly on the limbs
+    friend class PeBigIntAccumulator;
+
+    // Binary storage reads and writes the limbs directly
+    friend class PeBigIntView;
+
     // Members
 private:
-    int                 sign_;
-    std::vector<PeUint> digits_;
+    int        sign_;
+    LimbVector digits_;
+
+    // The number of zero limbs below digits_, so the magnitude is
+    // digits_ * kBase^offset_. This lets radix shifts, and products of
+    // shifted numbers, skip storing and multiplying runs of zero limbs.
+    // Zero always has an offset of zero.
+    size_t offset_;
 
     // The base used in our representation
     // and its power of ten, useful for determining
     // string lengths and radix shifts
-    static const PeUint kBase      = 100000000;
-    static const PeUint kBasePower = 8;
-
-    // Static regex for matching initialiser string
-    static const std::regex kValueStringRe;
+    static const PeUint kBase      = limbs::kBase;
+    static const PeUint kBasePower = limbs::kBasePower;
 }; // class PeBigInt
 
 } // namespace pe
+
+#include "PeBigIntExpr.h"
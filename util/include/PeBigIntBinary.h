@@ -0,0 +1,223 @@
+// Copyright 2020-2023 Paul Robertson
+//
+// PeBigIntBinary.h
+//
+// A binary limb variant of the arbitrary precision signed integer class
+
+#pragma once
+
+#include "PeDefinitions.h"
+#include "PeIntrinsics.h"
+#include "PeUtilities.h"
+
+#include <string>
+#include <vector>
+
+namespace pe
+{
+
+// An arbitrary precision signed integer class with the same interface as
+// PeBigInt, but storing its magnitude in full 64 bit (base 2^64) limbs
+// rather than base 10^8 limbs.
+//
+// Each limb holds over twice as many bits, and carries come straight from
+// add-with-carry and 128 bit products instead of a division by 10^8, so the
+// arithmetic operators are considerably faster. The trade off is that
+// decimal digits are only produced on demand: conversion to std::string,
+// sumDigits() and reverseDigits() all need a base conversion, which costs
+// a short division per 19 decimal digits.
+//
+// Existing PeBigInt callers should be able to switch to this class by
+// changing the type name alone. The one difference is radixShift(),
+// which shifts by this class' radix of 2^64 rather than 10^8.
+class PeBigIntBinary
+{
+public:
+    // Default constructor (gives a zero value)
+    PeBigIntBinary();
+
+    // Copy and move constructors
+    PeBigIntBinary(const PeBigIntBinary& that);
+    PeBigIntBinary(PeBigIntBinary&& that) noexcept;
+
+    // Constructors from integer types
+    PeBigIntBinary(int val);
+    PeBigIntBinary(long int val);
+    PeBigIntBinary(PeInt val);
+    PeBigIntBinary(unsigned val);
+    PeBigIntBinary(long unsigned val);
+    PeBigIntBinary(PeUint val);
+
+    // Constructors from floating point types
+    PeBigIntBinary(float val);
+    PeBigIntBinary(double val);
+    PeBigIntBinary(long double val);
+
+    // String constructors
+    // These accept the same strings as PeBigInt, i.e. [-+]?[0-9]+([eE][0-9]+)?
+    // Invalid strings give a zero value.
+    PeBigIntBinary(const char* valstr);
+    PeBigIntBinary(const std::string& valstr);
+
+    virtual ~PeBigIntBinary();
+
+    // Copy and move assignment operator
+    PeBigIntBinary& operator=(const PeBigIntBinary& rhs);
+    PeBigIntBinary& operator=(PeBigIntBinary&& rhs) noexcept;
+
+    // Unary operators
+    PeBigIntBinary operator-() const;
+
+    // Relational operators
+    bool operator<(const PeBigIntBinary& rhs) const;
+    bool operator>(const PeBigIntBinary& rhs) const;
+    bool operator<=(const PeBigIntBinary& rhs) const;
+    bool operator>=(const PeBigIntBinary& rhs) const;
+    bool operator==(const PeBigIntBinary& rhs) const;
+    bool operator!=(const PeBigIntBinary& rhs) const;
+
+    // Arithmetic operators
+    PeBigIntBinary& operator+=(const PeBigIntBinary& rhs);
+    PeBigIntBinary& operator-=(const PeBigIntBinary& rhs);
+    PeBigIntBinary& operator*=(const PeBigIntBinary& rhs);
+    PeBigIntBinary& operator/=(const PeBigIntBinary& rhs);
+    PeBigIntBinary& operator%=(const PeBigIntBinary& rhs);
+
+    // Friends defined inside class body are inline and are hidden from non-ADL
+    // lookup Passing lhs by value helps optimise chains like a+b+c
+    friend inline PeBigIntBinary operator+(PeBigIntBinary lhs, const PeBigIntBinary& rhs)
+    {
+        lhs += rhs;
+        return lhs;
+    }
+
+    friend inline PeBigIntBinary operator-(PeBigIntBinary lhs, const PeBigIntBinary& rhs)
+    {
+        lhs -= rhs;
+        return lhs;
+    }
+
+    friend inline PeBigIntBinary operator*(PeBigIntBinary lhs, const PeBigIntBinary& rhs)
+    {
+        lhs *= rhs;
+        return lhs;
+    }
+
+    friend inline PeBigIntBinary operator/(PeBigIntBinary lhs, const PeBigIntBinary& rhs)
+    {
+        lhs /= rhs;
+        return lhs;
+    }
+
+    friend inline PeBigIntBinary operator%(PeBigIntBinary lhs, const PeBigIntBinary& rhs)
+    {
+        lhs %= rhs;
+        return lhs;
+    }
+
+    // Conversion operators
+    // Values that are too large for the data type
+    // will be converted to the maximum value for
+    // said data type.
+
+    // Conversion to integer types
+    operator PeInt() const;
+    operator PeUint() const;
+
+    // Conversion to floating point types
+    operator long double() const;
+
+    // Conversion to string (the only place decimal digits are generated)
+    operator std::string() const;
+
+    // Write the decimal representation to a caller supplied buffer, as
+    // PeBigInt::toChars(). Returns the number of characters written, which
+    // is at most toCharsSize().
+    size_t toChars(char* buffer) const;
+    size_t toCharsSize() const;
+
+    // Convenience zero test
+    bool isZero() const;
+
+    // Divide this number by rhs, leaving the quotient in this number and
+    // storing the remainder in <remainder>. Truncates towards zero, as
+    // PeBigInt::divmod(). Throws runtime_error if rhs is zero.
+    PeBigIntBinary& divmod(const PeBigIntBinary& rhs, PeBigIntBinary& remainder);
+
+    // Raise number to the power n
+    PeBigIntBinary& power(PeUint exponent);
+
+    // Radix shift by whole 64 bit limbs, i.e. multiply/divide by 2^(64n)
+    PeBigIntBinary& radixShift(PeInt n);
+
+    // Reverse this number's decimal digits
+    PeBigIntBinary& reverseDigits();
+
+    // Square this number i.e. n = n * n
+    PeBigIntBinary& square();
+
+    // Return the sum of this number's decimal digits (ignores sign)
+    PeBigIntBinary sumDigits();
+
+    // Private helper functions
+private:
+    // Initialiser functions
+    void fromSigned(PeInt val);
+    void fromUnsigned(PeUint val);
+    void fromFloating(long double val);
+    void fromString(const std::string& valstr);
+
+    // Helper functions for operator overloading.
+    // These typically work with the absolute value
+    // of the number.
+
+    // Comparison
+    bool absEq(const PeBigIntBinary& rhs) const;
+    bool absLt(const PeBigIntBinary& rhs) const;
+
+    // Arithmetic
+    PeBigIntBinary& absPlusEq(const PeBigIntBinary& rhs);
+    PeBigIntBinary& absMinusEq(const PeBigIntBinary& rhs);
+    PeBigIntBinary& absMultEq(const PeBigIntBinary& rhs);
+    PeBigIntBinary& absDivModEq(const PeBigIntBinary& rhs, PeBigIntBinary* remainder);
+
+    // Single limb helpers: this = this * multiplier + addend,
+    // and this = this / denominator returning the remainder
+    PeBigIntBinary& absShortMultAddEq(PeUint multiplier, PeUint addend);
+    PeUint          absShortDivEq(PeUint denominator);
+
+    // Decimal conversion: the magnitude as base 10^19 chunks,
+    // least significant first
+    std::vector<PeUint> toDecimalChunks() const;
+
+    // Divide and conquer decimal conversion helpers.
+    // <powers> holds (10^19)^(2^k) for k = 0, 1, ...
+    // appendDecimalChunks() splits this value by powers[level] and appends
+    // its chunks, padded to exactly 2^(level + 1) chunks if <pad> is set.
+    // fromDecimalChunks() is the inverse, combining <n> chunks.
+    static std::vector<PeBigIntBinary> decimalChunkPowers(size_t n_chunks);
+    void appendDecimalChunks(const std::vector<PeBigIntBinary>& powers, size_t level, bool pad,
+                             std::vector<PeUint>& chunks) const;
+    void fromDecimalChunks(const PeUint* chunks, size_t n, const std::vector<PeBigIntBinary>& powers);
+
+    // Utility
+
+    // Remove any leading zeros (keeping at least one limb)
+    void popLeadingZeros();
+
+    // Members
+private:
+    int                 sign_;
+    std::vector<PeUint> limbs_;
+
+    // The largest power of ten that fits in a limb and its exponent,
+    // used for decimal conversion
+    static const PeUint kDecimalChunk      = 10000000000000000000ull;
+    static const PeUint kDecimalChunkPower = 19;
+
+    // Size (in limbs or chunks) below which decimal conversion uses plain
+    // short division and multiply-add rather than divide and conquer
+    static const size_t kDecimalSplitThreshold = 48;
+}; // class PeBigIntBinary
+
+} // namespace pe
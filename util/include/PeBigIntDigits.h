@@ -0,0 +1,152 @@
+// Copyright 2020-2023 Paul Robertson
+//
+// PeBigIntDigits.h
+//
+// Iteration over the decimal digits of a PeBigInt
+
+#pragma once
+
+#include "PeDefinitions.h"
+#include "PeLimbArithmetic.h"
+
+#include <cstddef>
+#include <iterator>
+
+namespace pe
+{
+// Powers of ten up to the limb base, for picking digits out of limbs
+const PeUint kLimbDigitPowers[limbs::kBasePower] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000 };
+
+// Bidirectional iterator over the decimal digits of a limb array, most
+// significant digit first. Digits are read straight from the limbs, so
+// iterating never allocates. Dereferencing gives the digit as an int 0-9.
+// The limbs may be preceded by a run of implicit zero digits, for numbers
+// stored with a limb offset.
+class PeBigIntDigitIterator
+{
+public:
+    typedef std::bidirectional_iterator_tag iterator_category;
+    typedef int                             value_type;
+    typedef std::ptrdiff_t                  difference_type;
+    typedef const int*                      pointer;
+    typedef int                             reference;
+
+    PeBigIntDigitIterator() : limbs_(nullptr), position_(0), zero_digits_(0) {}
+
+    // <position> counts digits from the least significant end, plus one,
+    // so that begin() is the number of digits and end() is zero. The lowest
+    // <zero_digits> digits are zero and not held in the limbs.
+    PeBigIntDigitIterator(const PeUint* limbs, size_t position, size_t zero_digits = 0) :
+        limbs_(limbs), position_(position), zero_digits_(zero_digits)
+    {
+    }
+
+    int operator*() const
+    {
+        if ( position_ <= zero_digits_ ) {
+            return 0;
+        }
+
+        const size_t digit = position_ - zero_digits_ - 1;
+        return (int)(limbs_[digit / limbs::kBasePower] / kLimbDigitPowers[digit % limbs::kBasePower] % 10);
+    }
+
+    PeBigIntDigitIterator& operator++()
+    {
+        --position_;
+        return *this;
+    }
+
+    PeBigIntDigitIterator operator++(int)
+    {
+        PeBigIntDigitIterator previous(*this);
+        --position_;
+        return previous;
+    }
+
+    PeBigIntDigitIterator& operator--()
+    {
+        ++position_;
+        return *this;
+    }
+
+    PeBigIntDigitIterator operator--(int)
+    {
+        PeBigIntDigitIterator previous(*this);
+        ++position_;
+        return previous;
+    }
+
+    bool operator==(const PeBigIntDigitIterator& rhs) const
+    {
+        return position_ == rhs.position_;
+    }
+
+    bool operator!=(const PeBigIntDigitIterator& rhs) const
+    {
+        return position_ != rhs.position_;
+    }
+
+    // Members
+private:
+    const PeUint* limbs_;
+    size_t        position_;
+    size_t        zero_digits_;
+}; // class PeBigIntDigitIterator
+
+// The decimal digits of a PeBigInt's absolute value, as returned by
+// PeBigInt::digits(). Iterate with begin() and end() for the most
+// significant digit first, or rbegin() and rend() for the least significant
+// digit first, e.g.
+//
+//  for ( int digit: n.digits() ) { ... }
+//
+// The range refers to the number's limbs, so is only valid until the
+// number is next modified.
+class PeBigIntDigits
+{
+public:
+    typedef PeBigIntDigitIterator                        iterator;
+    typedef std::reverse_iterator<PeBigIntDigitIterator> reverse_iterator;
+
+    // <size> digits in all, of which the lowest <zero_digits> are zero and
+    // not held in the limbs
+    PeBigIntDigits(const PeUint* limbs, size_t size, size_t zero_digits = 0) :
+        limbs_(limbs), size_(size), zero_digits_(zero_digits)
+    {
+    }
+
+    iterator begin() const
+    {
+        return iterator(limbs_, size_, zero_digits_);
+    }
+
+    iterator end() const
+    {
+        return iterator(limbs_, 0, zero_digits_);
+    }
+
+    reverse_iterator rbegin() const
+    {
+        return reverse_iterator(end());
+    }
+
+    reverse_iterator rend() const
+    {
+        return reverse_iterator(begin());
+    }
+
+    // Number of digits
+    size_t size() const
+    {
+        return size_;
+    }
+
+    // Members
+private:
+    const PeUint* limbs_;
+    size_t        size_;
+    size_t        zero_digits_;
+}; // class PeBigIntDigits
+
+}; // namespace pe
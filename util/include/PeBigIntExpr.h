@@ -0,0 +1,398 @@
+// Copyright 2020-2023 Paul Robertson
+//
+// PeBigIntExpr.h
+//
+// Expression templates for lazily evaluated PeBigInt arithmetic
+
+#pragma once
+
+// This header is included at the end of PeBigInt.h and isn't meant to be
+// included on its own
+#include "PeBigInt.h"
+
+#include <type_traits>
+#include <utility>
+
+namespace pe
+{
+// The binary +, - and * operators on PeBigInt don't compute anything
+// themselves. Instead they return small expression objects recording the
+// operands, and the whole expression is evaluated once it's assigned to
+// (or used to construct) a PeBigInt. So
+//
+//  PeBigInt r = a * b + c * d - e;
+//
+// computes the two products into scratch limbs, then adds every term
+// straight into one accumulator, rather than creating a full size PeBigInt
+// for each intermediate result.
+//
+// Expressions hold references to named PeBigInt operands, and take
+// temporary operands (and sub-expressions) by move. Other operands, like
+// the 1 in n + 1, are converted into values the expression owns. So an
+// expression built only from temporaries can be stored, but one naming a
+// variable mustn't outlive it:
+//
+//  auto r = f() + g(); // r owns both operands
+//  auto r = a + b;     // r is an expression referring to a and b
+//  PeBigInt r = a + b; // r is a value
+//
+// Products of expressions (e.g. (a + b) * c) evaluate their expression
+// operands first, since a product needs both operands' limbs anyway.
+// Division and modulo always evaluate their operands.
+
+// Sums terms and products, keeping the positive and negative terms in
+// separate limb arrays so that only one subtraction is needed, in finish().
+// Like PeBigInt, both sums are held above a count of implicit zero limbs,
+// the lowest offset of any term so far.
+class PeBigIntAccumulator
+{
+public:
+    PeBigIntAccumulator();
+
+    // Add sign * value
+    void add(const PeBigInt& value, int sign);
+
+    // Add sign * lhs * rhs
+    void addProduct(const PeBigInt& lhs, const PeBigInt& rhs, int sign);
+
+    // Write the sum to <result>
+    void finish(PeBigInt& result);
+
+    // Private helper functions
+private:
+    // Add <limbs> (length n) times kBase^offset
+    void addLimbs(const PeUint* limbs, size_t n, size_t offset, bool negative);
+
+    // Members
+private:
+    PeBigInt::LimbVector positive_;
+    PeBigInt::LimbVector negative_;
+    size_t               offset_;
+}; // class PeBigIntAccumulator
+
+// Base class for all expressions (using the curiously recurring template
+// pattern), giving them the same conversions as a PeBigInt value
+template <typename E>
+class PeBigIntExpr
+{
+public:
+    const E& self() const
+    {
+        return static_cast<const E&>(*this);
+    }
+
+    // Evaluate the expression
+    PeBigInt eval() const
+    {
+        return PeBigInt(*this);
+    }
+
+    operator PeInt() const
+    {
+        return (PeInt)eval();
+    }
+
+    operator PeUint() const
+    {
+        return (PeUint)eval();
+    }
+
+    operator long double() const
+    {
+        return (long double)eval();
+    }
+
+    operator std::string() const
+    {
+        return (std::string)eval();
+    }
+}; // class PeBigIntExpr
+
+// A named PeBigInt operand, held by reference
+class PeBigIntRef
+{
+public:
+    PeBigIntRef(const PeBigInt& value) : value_(value) {}
+
+    const PeBigInt& value() const
+    {
+        return value_;
+    }
+
+    void accumulate(PeBigIntAccumulator& acc, int sign) const
+    {
+        acc.add(value_, sign);
+    }
+
+    // Members
+private:
+    const PeBigInt& value_;
+}; // class PeBigIntRef
+
+// A temporary operand, moved (or converted) into the expression
+class PeBigIntValue
+{
+public:
+    PeBigIntValue(PeBigInt value) : value_(std::move(value)) {}
+
+    const PeBigInt& value() const
+    {
+        return value_;
+    }
+
+    void accumulate(PeBigIntAccumulator& acc, int sign) const
+    {
+        acc.add(value_, sign);
+    }
+
+    // Members
+private:
+    PeBigInt value_;
+}; // class PeBigIntValue
+
+// Whether T (after removing references and const) is an expression type
+template <typename T>
+struct PeIsBigIntExpr
+{
+    typedef typename std::decay<T>::type Type;
+
+    static const bool value = std::is_base_of<PeBigIntExpr<Type>, Type>::value;
+};
+
+// How an operand, of type T as deduced by a forwarding reference, is held
+// in an expression: a named PeBigInt by reference, an expression by value,
+// and anything else (temporary PeBigInts, and values converted to PeBigInt)
+// as a PeBigIntValue
+template <typename T, bool = PeIsBigIntExpr<T>::value>
+struct PeBigIntOperand
+{
+    typedef typename std::decay<T>::type Type;
+};
+
+template <typename T>
+struct PeBigIntOperand<T, false>
+{
+    typedef typename std::conditional<std::is_lvalue_reference<T>::value &&
+                                          std::is_same<typename std::decay<T>::type, PeBigInt>::value,
+                                      PeBigIntRef, PeBigIntValue>::type Type;
+};
+
+// Whether L and R are operands of a lazy sum (allowing expressions) or
+// product (not allowing them). At least one must be a PeBigInt or an
+// expression, and the other must convert to a PeBigInt.
+template <typename L, typename R, bool AllowExpr>
+struct PeIsBigIntOperands
+{
+    template <typename T>
+    struct IsBigInt
+    {
+        static const bool value = std::is_same<typename std::decay<T>::type, PeBigInt>::value ||
+                                  (AllowExpr && PeIsBigIntExpr<T>::value);
+    };
+
+    template <typename T>
+    struct IsOperand
+    {
+        static const bool value = (AllowExpr || !PeIsBigIntExpr<T>::value) && std::is_convertible<T, PeBigInt>::value;
+    };
+
+    static const bool value =
+        (IsBigInt<L>::value || IsBigInt<R>::value) && IsOperand<L>::value && IsOperand<R>::value;
+};
+
+// The product of two PeBigInt operands, each a PeBigIntRef or PeBigIntValue
+template <typename L, typename R>
+class PeBigIntProduct : public PeBigIntExpr<PeBigIntProduct<L, R>>
+{
+public:
+    PeBigIntProduct(L lhs, R rhs) : lhs_(std::move(lhs)), rhs_(std::move(rhs)) {}
+
+    void accumulate(PeBigIntAccumulator& acc, int sign) const
+    {
+        acc.addProduct(lhs_.value(), rhs_.value(), sign);
+    }
+
+    // Members
+private:
+    L lhs_;
+    R rhs_;
+}; // class PeBigIntProduct
+
+// The sum (or difference, if rhs_sign is -1) of two operands, each of which
+// is a PeBigIntRef, a PeBigIntValue or another expression
+template <typename L, typename R>
+class PeBigIntSum : public PeBigIntExpr<PeBigIntSum<L, R>>
+{
+public:
+    PeBigIntSum(L lhs, R rhs, int rhs_sign) : lhs_(std::move(lhs)), rhs_(std::move(rhs)), rhs_sign_(rhs_sign) {}
+
+    void accumulate(PeBigIntAccumulator& acc, int sign) const
+    {
+        lhs_.accumulate(acc, sign);
+        rhs_.accumulate(acc, sign * rhs_sign_);
+    }
+
+    // Members
+private:
+    L   lhs_;
+    R   rhs_;
+    int rhs_sign_;
+}; // class PeBigIntSum
+
+// PeBigInt members taking expressions
+template <typename E>
+PeBigInt::PeBigInt(const PeBigIntExpr<E>& expr) : sign_(1), offset_(0)
+{
+    PeBigIntAccumulator acc;
+    expr.self().accumulate(acc, 1);
+    acc.finish(*this);
+}
+
+// The expression is fully read before this number is written,
+// so it may refer to this number
+template <typename E>
+PeBigInt& PeBigInt::operator=(const PeBigIntExpr<E>& expr)
+{
+    PeBigIntAccumulator acc;
+    expr.self().accumulate(acc, 1);
+    acc.finish(*this);
+
+    return *this;
+}
+
+// Addition and subtraction. Operands are forwarded, so that named PeBigInts
+// are held by reference while temporaries, including sub-expressions, are
+// moved into the result.
+template <typename L, typename R, typename = typename std::enable_if<PeIsBigIntOperands<L, R, true>::value>::type>
+PeBigIntSum<typename PeBigIntOperand<L>::Type, typename PeBigIntOperand<R>::Type> operator+(L&& lhs, R&& rhs)
+{
+    typedef typename PeBigIntOperand<L>::Type LhsOperand;
+    typedef typename PeBigIntOperand<R>::Type RhsOperand;
+
+    return PeBigIntSum<LhsOperand, RhsOperand>(LhsOperand(std::forward<L>(lhs)), RhsOperand(std::forward<R>(rhs)), 1);
+}
+
+template <typename L, typename R, typename = typename std::enable_if<PeIsBigIntOperands<L, R, true>::value>::type>
+PeBigIntSum<typename PeBigIntOperand<L>::Type, typename PeBigIntOperand<R>::Type> operator-(L&& lhs, R&& rhs)
+{
+    typedef typename PeBigIntOperand<L>::Type LhsOperand;
+    typedef typename PeBigIntOperand<R>::Type RhsOperand;
+
+    return PeBigIntSum<LhsOperand, RhsOperand>(LhsOperand(std::forward<L>(lhs)), RhsOperand(std::forward<R>(rhs)), -1);
+}
+
+// Multiplication of PeBigInts, holding the operands as for sums
+template <typename L, typename R, typename = typename std::enable_if<PeIsBigIntOperands<L, R, false>::value>::type>
+PeBigIntProduct<typename PeBigIntOperand<L>::Type, typename PeBigIntOperand<R>::Type> operator*(L&& lhs, R&& rhs)
+{
+    typedef typename PeBigIntOperand<L>::Type LhsOperand;
+    typedef typename PeBigIntOperand<R>::Type RhsOperand;
+
+    return PeBigIntProduct<LhsOperand, RhsOperand>(LhsOperand(std::forward<L>(lhs)), RhsOperand(std::forward<R>(rhs)));
+}
+
+// Products with expressions are evaluated straight away
+template <typename E>
+PeBigInt operator*(const PeBigIntExpr<E>& lhs, const PeBigInt& rhs)
+{
+    PeBigInt result(lhs);
+    result *= rhs;
+    return result;
+}
+
+template <typename E>
+PeBigInt operator*(const PeBigInt& lhs, const PeBigIntExpr<E>& rhs)
+{
+    PeBigInt result(rhs);
+    result *= lhs;
+    return result;
+}
+
+template <typename E1, typename E2>
+PeBigInt operator*(const PeBigIntExpr<E1>& lhs, const PeBigIntExpr<E2>& rhs)
+{
+    PeBigInt result(lhs);
+    result *= PeBigInt(rhs);
+    return result;
+}
+
+// Unary minus, evaluated straight away
+template <typename E>
+PeBigInt operator-(const PeBigIntExpr<E>& expr)
+{
+    return -PeBigInt(expr);
+}
+
+// Relational operators, comparing the evaluated expressions
+template <typename E>
+bool operator<(const PeBigIntExpr<E>& lhs, const PeBigInt& rhs)
+{
+    return PeBigInt(lhs) < rhs;
+}
+
+template <typename E>
+bool operator>(const PeBigIntExpr<E>& lhs, const PeBigInt& rhs)
+{
+    return PeBigInt(lhs) > rhs;
+}
+
+template <typename E>
+bool operator<=(const PeBigIntExpr<E>& lhs, const PeBigInt& rhs)
+{
+    return PeBigInt(lhs) <= rhs;
+}
+
+template <typename E>
+bool operator>=(const PeBigIntExpr<E>& lhs, const PeBigInt& rhs)
+{
+    return PeBigInt(lhs) >= rhs;
+}
+
+template <typename E>
+bool operator==(const PeBigIntExpr<E>& lhs, const PeBigInt& rhs)
+{
+    return PeBigInt(lhs) == rhs;
+}
+
+template <typename E>
+bool operator!=(const PeBigIntExpr<E>& lhs, const PeBigInt& rhs)
+{
+    return PeBigInt(lhs) != rhs;
+}
+
+template <typename E1, typename E2>
+bool operator<(const PeBigIntExpr<E1>& lhs, const PeBigIntExpr<E2>& rhs)
+{
+    return PeBigInt(lhs) < PeBigInt(rhs);
+}
+
+template <typename E1, typename E2>
+bool operator>(const PeBigIntExpr<E1>& lhs, const PeBigIntExpr<E2>& rhs)
+{
+    return PeBigInt(lhs) > PeBigInt(rhs);
+}
+
+template <typename E1, typename E2>
+bool operator<=(const PeBigIntExpr<E1>& lhs, const PeBigIntExpr<E2>& rhs)
+{
+    return PeBigInt(lhs) <= PeBigInt(rhs);
+}
+
+template <typename E1, typename E2>
+bool operator>=(const PeBigIntExpr<E1>& lhs, const PeBigIntExpr<E2>& rhs)
+{
+    return PeBigInt(lhs) >= PeBigInt(rhs);
+}
+
+template <typename E1, typename E2>
+bool operator==(const PeBigIntExpr<E1>& lhs, const PeBigIntExpr<E2>& rhs)
+{
+    return PeBigInt(lhs) == PeBigInt(rhs);
+}
+
+template <typename E1, typename E2>
+bool operator!=(const PeBigIntExpr<E1>& lhs, const PeBigIntExpr<E2>& rhs)
+{
+    return PeBigInt(lhs) != PeBigInt(rhs);
+}
+}; // namespace pe
@@ -0,0 +1,63 @@
+// Copyright 2020-2023 Paul Robertson
+//
+// PeBigIntModular.h
+//
+// Modular arithmetic on PeBigInt with a fixed modulus
+
+#pragma once
+
+#include "PeBigInt.h"
+#include "PeDefinitions.h"
+
+#include <string>
+
+namespace pe
+{
+// A modular arithmetic context for a fixed modulus m > 0.
+//
+// Construction precomputes the constant for Barrett reduction, after which
+// every product is reduced with two multiplications and a few subtractions
+// rather than a long division. Results are always in the range [0, m), so
+// values stay the size of the modulus however large the exponent in powMod()
+// gets, e.g. the last ten digits of 2^(10^100):
+//
+//  PeBigIntModular mod(PeBigInt("1e10"));
+//  PeBigInt        last_ten = mod.powMod(2, PeBigInt("1e100"));
+//
+// Barrett reduction is used rather than Montgomery multiplication because
+// PeBigInt's radix is 10^8: Montgomery needs the modulus to be coprime to the
+// radix, which would rule out any even modulus or multiple of 5, including
+// the powers of ten that "last n digits" problems use.
+class PeBigIntModular
+{
+public:
+    // Throws runtime_error if the modulus isn't positive
+    explicit PeBigIntModular(const PeBigInt& modulus);
+
+    const PeBigInt& modulus() const;
+
+    // x mod m for any x, in the range [0, m)
+    PeBigInt reduce(const PeBigInt& x) const;
+
+    // a * b mod m
+    PeBigInt mulMod(const PeBigInt& a, const PeBigInt& b) const;
+
+    // base^exponent mod m, with 0^0 taken as 1.
+    // Throws runtime_error for a negative exponent.
+    PeBigInt powMod(const PeBigInt& base, PeUint exponent) const;
+    PeBigInt powMod(const PeBigInt& base, const PeBigInt& exponent) const;
+
+    // Private helper functions
+private:
+    // Barrett reduction of 0 <= x < kBase^(2n)
+    PeBigInt barrettReduce(const PeBigInt& x) const;
+
+    // Members
+private:
+    PeBigInt modulus_;
+    size_t   n_;     // Limbs in the modulus
+    PeBigInt mu_;    // floor(kBase^(2n) / m)
+    PeBigInt bound_; // kBase^(2n), the limit for barrettReduce()
+}; // class PeBigIntModular
+
+}; // namespace pe
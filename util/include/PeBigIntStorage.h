@@ -0,0 +1,174 @@
+// Copyright 2020-2023 Paul Robertson
+//
+// PeBigIntStorage.h
+//
+// Binary files of PeBigInt values, and zero copy loading by memory mapping
+
+#pragma once
+
+#include "PeBigInt.h"
+#include "PeBigIntDigits.h"
+#include "PeDefinitions.h"
+
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace pe
+{
+// Binary files hold a list of PeBigInt values in their limb representation,
+// so loading them needs no decimal parsing. The layout is:
+//
+//  magic        8 bytes  "PEBIGINT"
+//  version      4 bytes  kBigIntFileVersion
+//  limb digits  4 bytes  the decimal digits per limb (limbs::kBasePower)
+//  count        8 bytes  number of values, n
+//  index        8 bytes  x (n + 1), the byte offset of each record from the
+//                        start of the file, then the offset of the end of
+//                        the last record
+//  records      for each value: an 8 byte signed limb count, negative for
+//               negative values, followed by the limbs, least significant
+//               first (8 bytes each)
+//
+// Every field is 8 byte aligned, so a memory mapped file can be read in
+// place. Fields are in the machine's byte order; files written on a machine
+// with a different byte order (or a different limb base) fail the header
+// checks rather than loading wrong values.
+const PeUint kBigIntFileVersion = 1;
+
+// A read-only view of a PeBigInt held elsewhere, e.g. in a memory mapped
+// file or in a PeBigInt. The view doesn't own its limbs, so it's only valid
+// while they are. value() makes an ordinary PeBigInt for arithmetic.
+//
+// The limbs themselves aren't checked, so limbs(), digits() and comparisons
+// of a view into a corrupt file see whatever the file holds. value() does
+// check them, as a PeBigInt with bad limbs isn't safe to use.
+class PeBigIntView
+{
+public:
+    PeBigIntView() : sign_(1), limbs_(nullptr), size_(0), offset_(0) {}
+
+    // View the limbs of an existing number
+    explicit PeBigIntView(const PeBigInt& value);
+
+    // View <size> limbs (size >= 1), least significant first, above
+    // <offset> implicit zero limbs
+    PeBigIntView(int sign, const PeUint* limbs, size_t size, size_t offset = 0) :
+        sign_(sign), limbs_(limbs), size_(size), offset_(offset)
+    {
+    }
+
+    // 1 or -1 (zero is positive)
+    int sign() const
+    {
+        return sign_;
+    }
+
+    // The limbs, least significant first
+    const PeUint* limbs() const
+    {
+        return limbs_;
+    }
+
+    size_t size() const
+    {
+        return size_;
+    }
+
+    // The number of zero limbs below limbs(), see PeBigInt::radixShift().
+    // Views of a file always have an offset of zero.
+    size_t offset() const
+    {
+        return offset_;
+    }
+
+    bool isZero() const;
+
+    // The number of decimal digits (1 for zero)
+    size_t numDigits() const;
+
+    // The decimal digits, see PeBigIntDigits.h
+    PeBigIntDigits digits() const;
+
+    // Copy the value into a PeBigInt. Throws runtime_error if a limb is
+    // kBase or more, or if there's more than one limb and the top one is zero.
+    PeBigInt value() const;
+
+    bool operator==(const PeBigIntView& rhs) const;
+    bool operator!=(const PeBigIntView& rhs) const;
+
+    // Members
+private:
+    int           sign_;
+    const PeUint* limbs_;
+    size_t        size_;
+    size_t        offset_;
+}; // class PeBigIntView
+
+// Write values in the binary format to a stream opened in binary mode, or
+// to a file. Throws runtime_error if writing fails.
+void WriteBigInts(std::ostream& out, const std::vector<PeBigInt>& values);
+void SaveBigInts(const std::string& path, const std::vector<PeBigInt>& values);
+void SaveBigInt(const std::string& path, const PeBigInt& value);
+
+// Read all values from a binary stream, copying them into PeBigInts.
+// Throws runtime_error if the stream isn't a valid file, including any
+// record that value() would reject. Memory use is bounded by the data in
+// the stream, whatever its lengths and offsets claim.
+std::vector<PeBigInt> ReadBigInts(std::istream& in);
+
+// A binary file mapped into memory, read-only. Opening checks the header
+// and index, and each value is then a PeBigIntView straight into the
+// mapping, so a table of any size loads without copying or parsing and only
+// the pages that are read come in from disk. e.g.
+//
+//  PeBigIntMappedFile table("factorials.bin");
+//  PeUint             sum = table[1000].value().digitSum();
+//
+// Views are valid for the lifetime of the PeBigIntMappedFile.
+class PeBigIntMappedFile
+{
+public:
+    // Throws runtime_error if the file can't be opened or isn't valid
+    explicit PeBigIntMappedFile(const std::string& path);
+
+    // The mapping belongs to one object, so can't be copied
+    PeBigIntMappedFile(const PeBigIntMappedFile& that) = delete;
+    PeBigIntMappedFile& operator=(const PeBigIntMappedFile& rhs) = delete;
+
+    ~PeBigIntMappedFile();
+
+    // Number of values
+    size_t size() const;
+
+    // The value at <index>, unchecked
+    PeBigIntView operator[](size_t index) const;
+
+    // The value at <index>. Throws runtime_error if out of range.
+    PeBigIntView at(size_t index) const;
+
+    // Copy every value into a PeBigInt
+    std::vector<PeBigInt> values() const;
+
+    // Private helper functions
+private:
+    // Check the header, index and record lengths
+    void validate();
+
+    void unmap();
+
+    // Members
+private:
+    const unsigned char* data_;
+    size_t               bytes_;
+    size_t               count_;
+    const PeUint*        index_;
+
+#if defined(_WIN32)
+    void* file_;
+    void* mapping_;
+#endif
+}; // class PeBigIntMappedFile
+
+}; // namespace pe
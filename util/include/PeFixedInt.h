@@ -0,0 +1,341 @@
+// Copyright 2020-2023 Paul Robertson
+//
+// PeFixedInt.h
+//
+// A fixed width unsigned integer template, usable in constant expressions
+
+#pragma once
+
+#include "PeDefinitions.h"
+
+#include <cstddef>
+#include <string>
+#include <type_traits>
+
+// Loops over the limbs have fixed trip counts, which compilers will only
+// fully unroll below some size unless asked
+#if defined(__clang__)
+#define PE_UNROLL_LIMBS _Pragma("unroll")
+#elif defined(__GNUC__)
+#define PE_UNROLL_LIMBS _Pragma("GCC unroll 16")
+#else
+#define PE_UNROLL_LIMBS
+#endif
+
+namespace pe
+{
+class PeBigInt;
+
+// 64 x 64 -> 128 bit multiplication that can be evaluated at compile time.
+// Returns the low word of a * b and writes the high word to <hi>. Compilers
+// without a 128 bit type (i.e. MSVC) build the product from 32 bit halves,
+// since their wide multiplication intrinsic isn't constexpr.
+constexpr PeUint FixedMulWide(PeUint a, PeUint b, PeUint& hi)
+{
+#if defined(__SIZEOF_INT128__)
+    const unsigned __int128 prod = (unsigned __int128)a * b;
+    hi                           = (PeUint)(prod >> 64);
+    return (PeUint)prod;
+#else
+    const PeUint a_lo = a & 0xffffffffu;
+    const PeUint a_hi = a >> 32;
+    const PeUint b_lo = b & 0xffffffffu;
+    const PeUint b_hi = b >> 32;
+
+    const PeUint lo_lo = a_lo * b_lo;
+    const PeUint hi_lo = a_hi * b_lo;
+    const PeUint lo_hi = a_lo * b_hi;
+    const PeUint hi_hi = a_hi * b_hi;
+
+    // Middle column, which can't overflow
+    const PeUint middle = (lo_lo >> 32) + (hi_lo & 0xffffffffu) + lo_hi;
+
+    hi = hi_hi + (hi_lo >> 32) + (middle >> 32);
+    return (middle << 32) | (lo_lo & 0xffffffffu);
+#endif
+}
+
+// An unsigned integer of exactly <Bits> bits (a multiple of 64), held in an
+// inline array of 64 bit limbs.
+//
+// For values with a known bound this avoids everything PeBigInt does to
+// handle arbitrary sizes: there's no limb vector to size or allocate, no
+// sign and no normalisation, and every loop has a fixed trip count, so the
+// compiler can unroll it completely. Arithmetic wraps modulo 2^Bits, just
+// as built in unsigned integers do, so the bound is the caller's to keep.
+//
+// Everything except the PeBigInt and string conversions (which are in
+// PeFixedIntConversions.h) is constexpr, so tables can be built at compile
+// time, e.g.
+//
+//  struct PowersOfThree { PeFixedInt<256> values[100]; };
+//
+//  constexpr PowersOfThree MakePowersOfThree()
+//  {
+//      PowersOfThree table{};
+//      table.values[0] = 1;
+//      for ( size_t i = 1; i < 100; ++i ) {
+//          table.values[i] = table.values[i - 1] * 3;
+//      }
+//      return table;
+//  }
+//
+//  constexpr PowersOfThree kPowersOfThree = MakePowersOfThree();
+template <size_t Bits>
+class PeFixedInt
+{
+    static_assert((Bits > 0) && (Bits % 64 == 0), "PeFixedInt: Bits must be a positive multiple of 64.");
+
+public:
+    static const size_t kLimbs = Bits / 64;
+
+    // Default constructor (gives a zero value)
+    constexpr PeFixedInt() : limbs_{} {}
+
+    // Constructor from any integer type. Negative values wrap modulo
+    // 2^Bits, i.e. they are sign extended.
+    template <typename T, typename = typename std::enable_if<std::is_integral<T>::value>::type>
+    constexpr PeFixedInt(T val) : limbs_{}
+    {
+        limbs_[0]        = (PeUint)val;
+        const PeUint ext = val < 0 ? ~PeUint(0) : 0;
+        for ( size_t i = 1; i < kLimbs; ++i ) {
+            limbs_[i] = ext;
+        }
+    }
+
+    // Conversions from and to PeBigInt, which need PeFixedIntConversions.h.
+    // Values of PeBigInt outside the range [0, 2^Bits) wrap modulo 2^Bits.
+    explicit PeFixedInt(const PeBigInt& value);
+    explicit operator PeBigInt() const;
+    explicit operator std::string() const;
+
+    // The 64 bit limbs, least significant first
+    constexpr PeUint limb(size_t i) const
+    {
+        return limbs_[i];
+    }
+
+    constexpr PeUint& limb(size_t i)
+    {
+        return limbs_[i];
+    }
+
+    constexpr bool isZero() const
+    {
+        PeUint any = 0;
+        PE_UNROLL_LIMBS
+        for ( size_t i = 0; i < kLimbs; ++i ) {
+            any |= limbs_[i];
+        }
+        return any == 0;
+    }
+
+    // Relational operators
+    constexpr bool operator==(const PeFixedInt& rhs) const
+    {
+        PeUint diff = 0;
+        PE_UNROLL_LIMBS
+        for ( size_t i = 0; i < kLimbs; ++i ) {
+            diff |= limbs_[i] ^ rhs.limbs_[i];
+        }
+        return diff == 0;
+    }
+
+    constexpr bool operator!=(const PeFixedInt& rhs) const
+    {
+        return !operator==(rhs);
+    }
+
+    // From the most significant limb, stopping at the first difference
+    constexpr bool operator<(const PeFixedInt& rhs) const
+    {
+        PE_UNROLL_LIMBS
+        for ( size_t i = kLimbs; i > 0; --i ) {
+            if ( limbs_[i - 1] != rhs.limbs_[i - 1] ) {
+                return limbs_[i - 1] < rhs.limbs_[i - 1];
+            }
+        }
+        return false;
+    }
+
+    constexpr bool operator>(const PeFixedInt& rhs) const
+    {
+        return rhs < *this;
+    }
+
+    constexpr bool operator<=(const PeFixedInt& rhs) const
+    {
+        return !(rhs < *this);
+    }
+
+    constexpr bool operator>=(const PeFixedInt& rhs) const
+    {
+        return !(*this < rhs);
+    }
+
+    // Arithmetic operators, all modulo 2^Bits
+    constexpr PeFixedInt operator-() const
+    {
+        PeFixedInt result;
+        result -= *this;
+        return result;
+    }
+
+    constexpr PeFixedInt& operator+=(const PeFixedInt& rhs)
+    {
+        PeUint carry = 0;
+        PE_UNROLL_LIMBS
+        for ( size_t i = 0; i < kLimbs; ++i ) {
+            const PeUint sum = limbs_[i] + carry;
+            carry            = sum < carry;
+            limbs_[i]        = sum + rhs.limbs_[i];
+            carry += limbs_[i] < sum;
+        }
+        return *this;
+    }
+
+    constexpr PeFixedInt& operator-=(const PeFixedInt& rhs)
+    {
+        PeUint borrow = 0;
+        PE_UNROLL_LIMBS
+        for ( size_t i = 0; i < kLimbs; ++i ) {
+            const PeUint diff = limbs_[i] - rhs.limbs_[i];
+            const PeUint out  = (limbs_[i] < rhs.limbs_[i]) | (diff < borrow);
+            limbs_[i]         = diff - borrow;
+            borrow            = out;
+        }
+        return *this;
+    }
+
+    // Schoolbook multiplication, skipping the partial products that fall
+    // beyond the top limb
+    constexpr PeFixedInt& operator*=(const PeFixedInt& rhs)
+    {
+        PeFixedInt product;
+        PE_UNROLL_LIMBS
+        for ( size_t i = 0; i < kLimbs; ++i ) {
+            PeUint carry = 0;
+            PE_UNROLL_LIMBS
+            for ( size_t j = 0; i + j < kLimbs; ++j ) {
+                PeUint       hi = 0;
+                const PeUint lo = FixedMulWide(limbs_[i], rhs.limbs_[j], hi);
+
+                PeUint sum = product.limbs_[i + j] + lo;
+                hi += sum < lo;
+                sum += carry;
+                hi += sum < carry;
+
+                product.limbs_[i + j] = sum;
+                carry                 = hi;
+            }
+        }
+        *this = product;
+        return *this;
+    }
+
+    // Shifts by any number of bits (shifts of Bits or more give zero)
+    constexpr PeFixedInt& operator<<=(size_t n)
+    {
+        const size_t words = n / 64;
+        const size_t bits  = n % 64;
+        for ( size_t i = kLimbs; i > 0; --i ) {
+            const size_t to   = i - 1;
+            PeUint       word = 0;
+            if ( to >= words ) {
+                word = limbs_[to - words] << bits;
+                if ( (bits != 0) && (to > words) ) {
+                    word |= limbs_[to - words - 1] >> (64 - bits);
+                }
+            }
+            limbs_[to] = word;
+        }
+        return *this;
+    }
+
+    constexpr PeFixedInt& operator>>=(size_t n)
+    {
+        const size_t words = n / 64;
+        const size_t bits  = n % 64;
+        for ( size_t to = 0; to < kLimbs; ++to ) {
+            PeUint word = 0;
+            if ( to + words < kLimbs ) {
+                word = limbs_[to + words] >> bits;
+                if ( (bits != 0) && (to + words + 1 < kLimbs) ) {
+                    word |= limbs_[to + words + 1] << (64 - bits);
+                }
+            }
+            limbs_[to] = word;
+        }
+        return *this;
+    }
+
+    friend constexpr PeFixedInt operator+(PeFixedInt lhs, const PeFixedInt& rhs)
+    {
+        return lhs += rhs;
+    }
+
+    friend constexpr PeFixedInt operator-(PeFixedInt lhs, const PeFixedInt& rhs)
+    {
+        return lhs -= rhs;
+    }
+
+    friend constexpr PeFixedInt operator*(PeFixedInt lhs, const PeFixedInt& rhs)
+    {
+        return lhs *= rhs;
+    }
+
+    friend constexpr PeFixedInt operator<<(PeFixedInt lhs, size_t n)
+    {
+        return lhs <<= n;
+    }
+
+    friend constexpr PeFixedInt operator>>(PeFixedInt lhs, size_t n)
+    {
+        return lhs >>= n;
+    }
+
+    // this = this * m + a, modulo 2^Bits
+    constexpr PeFixedInt& mulAddSmall(PeUint m, PeUint a)
+    {
+        PeUint carry = a;
+        for ( size_t i = 0; i < kLimbs; ++i ) {
+            PeUint       hi  = 0;
+            const PeUint lo  = FixedMulWide(limbs_[i], m, hi);
+            const PeUint sum = lo + carry;
+            limbs_[i]        = sum;
+            carry            = hi + (sum < lo);
+        }
+        return *this;
+    }
+
+    // Divide this number by 0 < d < 2^32, returning the remainder. Each
+    // limb is divided in 32 bit halves, so no wide division is needed.
+    constexpr PeUint divSmall(PeUint d)
+    {
+        PeUint remainder = 0;
+        for ( size_t i = kLimbs; i > 0; --i ) {
+            const PeUint high = (remainder << 32) | (limbs_[i - 1] >> 32);
+            const PeUint q_hi = high / d;
+            remainder         = high % d;
+
+            const PeUint low  = (remainder << 32) | (limbs_[i - 1] & 0xffffffffu);
+            const PeUint q_lo = low / d;
+            remainder         = low % d;
+
+            limbs_[i - 1] = (q_hi << 32) | q_lo;
+        }
+        return remainder;
+    }
+
+    // Members
+private:
+    PeUint limbs_[kLimbs];
+}; // class PeFixedInt
+
+// Common widths
+typedef PeFixedInt<128> PeUint128;
+typedef PeFixedInt<256> PeUint256;
+typedef PeFixedInt<512> PeUint512;
+
+}; // namespace pe
@@ -0,0 +1,67 @@
+// Copyright 2020-2023 Paul Robertson
+//
+// PeFixedIntConversions.h
+//
+// Conversions between PeFixedInt and PeBigInt
+
+#pragma once
+
+#include "PeBigInt.h"
+#include "PeBigIntStorage.h"
+#include "PeDefinitions.h"
+#include "PeFixedInt.h"
+
+#include <cstddef>
+#include <string>
+
+namespace pe
+{
+// These are kept out of PeFixedInt.h so that code using only fixed width
+// arithmetic doesn't pull in PeBigInt. Include this header wherever a
+// PeFixedInt is converted to or from a PeBigInt or string.
+
+template <size_t Bits>
+PeFixedInt<Bits>::PeFixedInt(const PeBigInt& value) : limbs_{}
+{
+    // Horner's rule over the base 10^8 limbs, then the offset's zero
+    // limbs. 10^8 is a multiple of 2^8, so past Bits / 8 of those the
+    // value is zero modulo 2^Bits.
+    const PeBigIntView view(value);
+    for ( size_t i = view.size(); i > 0; --i ) {
+        mulAddSmall(limbs::kBase, view.limbs()[i - 1]);
+    }
+    for ( size_t i = 0; (i < view.offset()) && (i < Bits / 8); ++i ) {
+        mulAddSmall(limbs::kBase, 0);
+    }
+
+    if ( view.sign() < 0 ) {
+        *this = -*this;
+    }
+}
+
+template <size_t Bits>
+PeFixedInt<Bits>::operator PeBigInt() const
+{
+    // Split into base 10^8 limbs, then rebuild from the top
+    PeUint     chunks[(Bits + 25) / 26]; // 10^8 > 2^26
+    size_t     n_chunks  = 0;
+    PeFixedInt remaining = *this;
+    do {
+        chunks[n_chunks++] = remaining.divSmall(limbs::kBase);
+    } while ( !remaining.isZero() );
+
+    PeBigInt result;
+    for ( size_t i = n_chunks; i > 0; --i ) {
+        result.radixShift(1);
+        result.addSmall((PeInt)chunks[i - 1]);
+    }
+
+    return result;
+}
+
+template <size_t Bits>
+PeFixedInt<Bits>::operator std::string() const
+{
+    return (std::string)(PeBigInt)*this;
+}
+}; // namespace pe
@@ -0,0 +1,104 @@
+// Copyright 2020-2023 Paul Robertson
+//
+// PeIntrinsics.h
+//
+// Portable wrappers for double width (128 bit) multiplication, division,
+// carry arithmetic, bit scans and bit counts on 64 bit words
+
+#pragma once
+
+#include "PeDefinitions.h"
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define PE_MSVC_INTRINSICS
+#endif
+
+namespace pe
+{
+namespace intrinsics
+{
+// Full 64 x 64 -> 128 bit multiplication.
+// Returns the low word of a * b and writes the high word to <hi>.
+inline PeUint MulWide(PeUint a, PeUint b, PeUint& hi)
+{
+#if defined(PE_MSVC_INTRINSICS)
+    return _umul128(a, b, &hi);
+#else
+    unsigned __int128 prod = (unsigned __int128)a * b;
+    hi                     = (PeUint)(prod >> 64);
+    return (PeUint)prod;
+#endif
+}
+
+// Divide the 128 bit value (hi, lo) by d, where hi < d so that the quotient
+// fits in 64 bits. Returns the quotient and writes the remainder to <rem>.
+inline PeUint DivWide(PeUint hi, PeUint lo, PeUint d, PeUint& rem)
+{
+#if defined(PE_MSVC_INTRINSICS)
+    return _udiv128(hi, lo, d, &rem);
+#else
+    unsigned __int128 num = ((unsigned __int128)hi << 64) | lo;
+    rem                   = (PeUint)(num % d);
+    return (PeUint)(num / d);
+#endif
+}
+
+// Add with carry: returns a + b + carry (mod 2^64) and updates <carry>
+// (which must be 0 or 1) with the carry out.
+inline PeUint AddCarry(PeUint a, PeUint b, PeUint& carry)
+{
+    PeUint sum = a + carry;
+    PeUint c   = sum < carry;
+    sum += b;
+    carry = c + (sum < b);
+    return sum;
+}
+
+// Subtract with borrow: returns a - b - borrow (mod 2^64) and updates
+// <borrow> (which must be 0 or 1) with the borrow out.
+inline PeUint SubBorrow(PeUint a, PeUint b, PeUint& borrow)
+{
+    PeUint diff = a - b;
+    PeUint c    = a < b;
+    c += diff < borrow;
+    diff -= borrow;
+    borrow = c;
+    return diff;
+}
+
+// Count leading zero bits of a non-zero word
+inline int CountLeadingZeros(PeUint x)
+{
+#if defined(PE_MSVC_INTRINSICS)
+    unsigned long index;
+    _BitScanReverse64(&index, x);
+    return 63 - (int)index;
+#else
+    return __builtin_clzll(x);
+#endif
+}
+
+// Count trailing zero bits of a non-zero word
+inline int CountTrailingZeros(PeUint x)
+{
+#if defined(PE_MSVC_INTRINSICS)
+    unsigned long index;
+    _BitScanForward64(&index, x);
+    return (int)index;
+#else
+    return __builtin_ctzll(x);
+#endif
+}
+
+// Count the set bits of a word
+inline int PopCount(PeUint x)
+{
+#if defined(PE_MSVC_INTRINSICS)
+    return (int)__popcnt64(x);
+#else
+    return __builtin_popcountll(x);
+#endif
+}
+}; // namespace intrinsics
+}; // namespace pe
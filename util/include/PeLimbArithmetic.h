@@ -0,0 +1,149 @@
+// Copyright 2020-2023 Paul Robertson
+//
+// PeLimbArithmetic.h
+//
+// Low level arithmetic on arrays of base 10^8 "limbs", as used by PeBigInt
+
+#pragma once
+
+#include "PeDefinitions.h"
+
+#include <cstddef>
+
+namespace pe
+{
+namespace limbs
+{
+// The base used for each limb and its power of ten.
+// This must match the representation used by PeBigInt.
+const PeUint kBase      = 100000000;
+const PeUint kBasePower = 8;
+
+// Crossover thresholds (in limbs) for the multiplication algorithms.
+// Below kKaratsubaThreshold the schoolbook method is used, between the two
+// thresholds Karatsuba is used and above kToom3Threshold Toom-3 is used.
+// Once the shorter operand reaches kNttThreshold limbs a number theoretic
+// transform is used instead, provided the product is no longer than
+// kNttMaxLength limbs.
+// These were tuned by timing square operands on a typical desktop machine.
+const size_t kKaratsubaThreshold = 96;
+const size_t kToom3Threshold     = 1000;
+const size_t kNttThreshold       = 4000;
+const size_t kNttMaxLength       = size_t(1) << 24;
+
+// Multiplications whose shorter operand has at least the parallel threshold
+// (kParallelMultiplyThreshold limbs by default) split their work across
+// threads: the NTT runs its three prime convolutions and its butterfly
+// passes in parallel, and Karatsuba and Toom-3 run their recursive products
+// in parallel. Nested splits share out the parent's threads, so no more than
+// MultiplyThreads() threads work on one product. Every split writes its own
+// part of the result, so results are identical for any number of threads.
+const size_t kParallelMultiplyThreshold = 16000;
+
+// Set the number of threads used for one multiplication. 0 (the default)
+// uses std::thread::hardware_concurrency() and 1 disables parallelism.
+void   SetMultiplyThreads(size_t threads);
+size_t MultiplyThreads();
+
+// Set the parallel threshold, in limbs of the shorter operand
+void   SetParallelMultiplyThreshold(size_t limbs);
+size_t ParallelMultiplyThreshold();
+
+// Crossover threshold (in limbs) for division. Once both the divisor and the
+// quotient reach kNewtonDivisionThreshold limbs, division by a Newton
+// iteration reciprocal is used instead of Knuth's Algorithm D.
+const size_t kNewtonDivisionThreshold = 2000;
+
+// Addition, subtraction and comparison use AVX2 or SSE4.2 kernels where the
+// CPU supports them, chosen at runtime with a scalar fallback.
+// Returns the name of the kernels in use: "avx2", "sse4.2" or "scalar".
+const char* SimdKernelName();
+
+// Add <a> (length na) to <r> (length nr) in place, where na <= nr.
+// Returns the carry out of the most significant limb of <r> (0 or 1).
+PeUint AddTo(PeUint* r, size_t nr, const PeUint* a, size_t na);
+
+// Subtract <a> (length na) from <r> (length nr) in place, where na <= nr.
+// Returns the borrow out of the most significant limb of <r> (0 or 1),
+// which will be zero if the value of <a> is no greater than <r>.
+PeUint SubtractFrom(PeUint* r, size_t nr, const PeUint* a, size_t na);
+
+// Compare <a> (length na) with <b> (length nb), ignoring any leading zero
+// limbs. Returns -1, 0 or 1 for a < b, a == b and a > b respectively.
+int Compare(const PeUint* a, size_t na, const PeUint* b, size_t nb);
+
+// Compare <a> (length na) times kBase^oa with <b> (length nb) times
+// kBase^ob, i.e. numbers with oa and ob implicit zero limbs below their
+// arrays. Returns -1, 0 or 1 as Compare().
+int CompareOffset(const PeUint* a, size_t na, size_t oa, const PeUint* b, size_t nb, size_t ob);
+
+// Divide <u> (length nu) in place by a single limb divisor 0 < d < kBase.
+// Returns the remainder.
+PeUint DivideSmall(PeUint* u, size_t nu, PeUint d);
+
+// Multiply <a> (length na) by a single limb multiplier m < kBase, writing
+// na + 1 limbs to <res>. The result may overlap <a> exactly.
+void MultiplySmall(const PeUint* a, size_t na, PeUint m, PeUint* res);
+
+// Add m * <a> (length na) to <r> (length nr) in place, where m < kBase and
+// na < nr. Returns the carry out of the most significant limb of <r>.
+// <a> may be <r> itself.
+PeUint MultiplySmallAddTo(PeUint* r, size_t nr, const PeUint* a, size_t na, PeUint m);
+
+// Subtract m * <a> (length na) from <r> (length nr) in place, where
+// m < kBase and na < nr. If m * a is larger than r, returns 1 and leaves
+// kBase^nr - (m * a - r) in <r>, which Negate() turns into the magnitude
+// of the difference. Otherwise returns 0. <a> may be <r> itself.
+PeUint MultiplySmallSubtractFrom(PeUint* r, size_t nr, const PeUint* a, size_t na, PeUint m);
+
+// Replace <r> (length nr) with kBase^nr - r, for any non-zero r
+void Negate(PeUint* r, size_t nr);
+
+// Decimal text helpers
+
+// Test whether all <n> characters of <str> are ASCII digits.
+// Uses SSE2 to test 16 characters at a time where available.
+bool AllDigits(const char* str, size_t n);
+
+// Convert exactly kBasePower ASCII digits to a limb value.
+// Uses a SWAR (SIMD within a register) reduction on little endian targets.
+PeUint ParseLimb(const char* str);
+
+// Write a limb value as exactly kBasePower zero padded ASCII digits
+void FormatLimb(PeUint limb, char* str);
+
+// Multiply <a> (length na) by <b> (length nb), writing exactly na + nb limbs
+// to <res>. The result array must not overlap either input.
+// This dispatches to schoolbook, Karatsuba or Toom-3 multiplication
+// depending on the operand sizes.
+void Multiply(const PeUint* a, size_t na, const PeUint* b, size_t nb, PeUint* res);
+
+// Square <a> (length na), writing exactly 2 * na limbs to <res>, which must
+// not overlap <a>. Multiply() with the same array for both operands does
+// the same: each algorithm then computes the shared parts of the operands
+// once and passes squares down to a schoolbook square for small sizes.
+void Square(const PeUint* a, size_t na, PeUint* res);
+
+// Individual multiplication algorithms, with the same contract as Multiply().
+// These are exposed mostly for testing and tuning; Multiply() should normally
+// be used instead. Karatsuba requires nb <= na < 2 * nb, Toom-3 requires
+// nb <= na and that <b> is longer than two thirds of <a>, and the NTT
+// requires na + nb <= kNttMaxLength.
+void MultiplySchoolbook(const PeUint* a, size_t na, const PeUint* b, size_t nb, PeUint* res);
+void SquareSchoolbook(const PeUint* a, size_t na, PeUint* res);
+void MultiplyKaratsuba(const PeUint* a, size_t na, const PeUint* b, size_t nb, PeUint* res);
+void MultiplyToom3(const PeUint* a, size_t na, const PeUint* b, size_t nb, PeUint* res);
+void MultiplyNtt(const PeUint* a, size_t na, const PeUint* b, size_t nb, PeUint* res);
+
+// Divide <u> (length nu) by <v> (length nv), where nu >= nv and the most
+// significant limb of <v> is non-zero. Writes nu - nv + 1 quotient limbs
+// to <q> and nv remainder limbs to <r>. Either output may be null if it isn't
+// needed; neither may overlap the inputs.
+// This dispatches to Algorithm D or Newton division depending on sizes.
+void Divide(const PeUint* u, size_t nu, const PeUint* v, size_t nv, PeUint* q, PeUint* r);
+
+// Individual division algorithms, with the same contract as Divide().
+void DivideKnuth(const PeUint* u, size_t nu, const PeUint* v, size_t nv, PeUint* q, PeUint* r);
+void DivideNewton(const PeUint* u, size_t nu, const PeUint* v, size_t nv, PeUint* q, PeUint* r);
+}; // namespace limbs
+}; // namespace pe
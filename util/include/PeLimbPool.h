@@ -0,0 +1,130 @@
+// Copyright 2020-2023 Paul Robertson
+//
+// PeLimbPool.h
+//
+// Recycling of heap blocks for big integer limb storage
+
+#pragma once
+
+#include "PeDefinitions.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace pe
+{
+// A cache of heap blocks, grouped into power of two size classes.
+//
+// Big integer arithmetic creates and destroys many short-lived limb buffers
+// of similar sizes. Rather than handing these back to the global allocator,
+// freed blocks are kept on a per size class free list and reused by the next
+// request of the same class. Blocks are plain malloc() blocks, so any pool
+// can free or reuse a block allocated by any other pool.
+//
+// Each thread has a default pool, used automatically by PeBigInt. A
+// PeLimbPoolScope can be used to give a section of code its own pool, whose
+// cached blocks are all released when the scope ends.
+//
+// A pool caches at most max_cached_bytes of blocks, freeing any returned
+// block that would take it over. The default pools live as long as their
+// threads, so this bounds what each thread keeps hold of.
+class PeLimbPool
+{
+public:
+    // Cache limit for pools, including the default pools (64 MB)
+    static const size_t kDefaultMaxCachedBytes = size_t(1) << 26;
+
+    explicit PeLimbPool(size_t max_cached_bytes = kDefaultMaxCachedBytes);
+
+    // Pools own their cached blocks, so can't be copied
+    PeLimbPool(const PeLimbPool& that) = delete;
+    PeLimbPool& operator=(const PeLimbPool& rhs) = delete;
+
+    // Frees all cached blocks
+    ~PeLimbPool();
+
+    // Allocate a block of at least <bytes> bytes. On return <bytes> holds
+    // the usable size of the block, which must be passed back to
+    // deallocate(). Throws bad_alloc on failure.
+    void* allocate(size_t& bytes);
+
+    // Return a block to the pool (or to the heap, if its free list is full)
+    void deallocate(void* block, size_t bytes);
+
+    // Free all cached blocks
+    void release();
+
+    // Free cached blocks, largest first, until at most <max_bytes> remain
+    void trim(size_t max_bytes);
+
+    // Total size of the blocks currently held in the free lists
+    size_t cachedBytes() const;
+
+    // The cache limit. Lowering it trims the pool to the new limit.
+    size_t maxCachedBytes() const;
+    void   setMaxCachedBytes(size_t max_cached_bytes);
+
+    // The pool in use by this thread: the innermost live PeLimbPoolScope,
+    // or the thread's default pool
+    static PeLimbPool& current();
+
+    // Allocate from or deallocate to the current pool.
+    // These fall back to the heap during thread shutdown, once the default
+    // pool has been destroyed.
+    static void* allocateCurrent(size_t& bytes);
+    static void  deallocateCurrent(void* block, size_t bytes);
+
+    // Members
+private:
+    // Size classes are 2^kMinClass to 2^kMaxClass bytes (64 bytes to 16 MB).
+    // Larger blocks go straight to the heap.
+    static const size_t kMinClass          = 6;
+    static const size_t kMaxClass          = 24;
+    static const size_t kMaxBlocksPerClass = 16;
+
+    std::vector<void*> free_blocks_[kMaxClass + 1];
+    size_t             cached_bytes_;
+    size_t             max_cached_bytes_;
+}; // class PeLimbPool
+
+// Makes a fresh pool current for this thread for the lifetime of the scope
+// object. Scopes nest, and must be destroyed in reverse order of creation
+// (which is automatic for local variables).
+//
+// e.g.
+//  {
+//      PeLimbPoolScope scope;
+//      PeBigInt        n(2);
+//      n.power(100000); // Limb buffers recycled via scope.pool()
+//  }                    // Cached blocks freed here
+class PeLimbPoolScope
+{
+public:
+    explicit PeLimbPoolScope(size_t max_cached_bytes = PeLimbPool::kDefaultMaxCachedBytes);
+    ~PeLimbPoolScope();
+
+    PeLimbPoolScope(const PeLimbPoolScope& that) = delete;
+    PeLimbPoolScope& operator=(const PeLimbPoolScope& rhs) = delete;
+
+    PeLimbPool& pool();
+
+    // Members
+private:
+    PeLimbPool  pool_;
+    PeLimbPool* previous_;
+}; // class PeLimbPoolScope
+
+// Allocator policy for PeSmallVector drawing from the current thread's pool
+struct PeLimbPoolAllocator
+{
+    static void* allocate(size_t& bytes)
+    {
+        return PeLimbPool::allocateCurrent(bytes);
+    }
+
+    static void deallocate(void* block, size_t bytes)
+    {
+        PeLimbPool::deallocateCurrent(block, bytes);
+    }
+};
+}; // namespace pe
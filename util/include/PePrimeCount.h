@@ -0,0 +1,51 @@
+// Copyright 2020-2023 Paul Robertson
+//
+// PePrimeCount.h
+//
+// Counting and summing primes without listing them
+
+#pragma once
+
+#include "PeDefinitions.h"
+#include "PeFixedInt.h"
+
+namespace pe
+{
+namespace math
+{
+// Both methods here work with S(v), the number (or sum) of the primes up
+// to v. Lucy_Hedgehog's method finds S(v) for every v = n / k (rounded
+// down), of which there are only 2 * sqrt(n). Each S(v) starts as the
+// count (or sum) of all of [2, v], then the multiples of each prime p up
+// to sqrt(n) are taken out in turn:
+//
+//  S(v) -= f(p) * (S(v / p) - S(p - 1))    for v >= p^2
+//
+// where f(p) is 1 for counting and p for summing. This takes O(n^(3/4))
+// time and O(sqrt(n)) memory.
+//
+// The Meissel-Lehmer method instead counts (or sums) the numbers up to n
+// with no prime factor up to cbrt(n), by a recursion over those primes,
+// then takes off the products of two larger primes, using a table of the
+// primes up to n^(2/3). This takes less time for large n, but O(n^(2/3))
+// memory (about 40 MB at 10^12).
+//
+// Sums need more than 64 bits beyond about 3 * 10^10, so are 128 bit.
+
+// From this on, PrimePi() and PrimeSum() use the Meissel-Lehmer method.
+// This was found by timing both.
+const PeUint kPrimeCountMeisselThreshold = 4000000000;
+
+// The number of primes up to <n>, and their sum
+PeUint    PrimePi(PeUint n);
+PeUint128 PrimeSum(PeUint n);
+
+// Individual methods, with the same results as above. These are exposed
+// mostly for testing and tuning; PrimePi() and PrimeSum() should normally
+// be used instead.
+PeUint    PrimePiLucy(PeUint n);
+PeUint128 PrimeSumLucy(PeUint n);
+PeUint    PrimePiMeissel(PeUint n);
+PeUint128 PrimeSumMeissel(PeUint n);
+}; // namespace math
+}; // namespace pe
@@ -0,0 +1,270 @@
+// Copyright 2020-2023 Paul Robertson
+//
+// PePrimeSieve.h
+//
+// Segmented Sieve of Eratosthenes over the odd numbers
+
+#pragma once
+
+#include "PeDefinitions.h"
+#include "PeFixedInt.h"
+#include "PeIntrinsics.h"
+
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+namespace pe
+{
+// Bytes of flags in each segment of a PeSegmentedSieve. Each bit stands for
+// one odd number, so a segment covers 16 times this many integers. The
+// default fits in the L1 data cache of current desktop CPUs. L2 sized
+// segments are a little faster (about 10%) for ranges of 10^10 and up,
+// but slower below that.
+const size_t kSieveSegmentBytes = 32768;
+
+// floor(sqrt(n)), exact for any 64 bit n
+PeUint FloorSqrt(PeUint n);
+
+// A segmented Sieve of Eratosthenes over the odd numbers in [low, high].
+//
+// Rather than one flag per integer across the whole range, the range is
+// sieved one cache sized segment at a time, holding one bit per odd number.
+// Each segment starts from a repeating pattern with the multiples of 3, 5,
+// 7, 11 and 13 already crossed off, then has the multiples of the larger
+// sieving primes crossed off. Each sieving prime remembers where its next
+// multiple is, so moving on to the next segment needs no divisions. Memory
+// use is one segment plus the sieving primes, whatever the range.
+//
+// Sieve segments in order with next(), then read the primes in the current
+// segment, e.g.
+//
+//  std::vector<PeUint> seeds = PeSegmentedSieve::SievingPrimes(high);
+//  PeSegmentedSieve    sieve(low, high, seeds);
+//  while ( sieve.next() ) {
+//      sieve.forEachPrime([&](PeUint p) { ... });
+//  }
+//
+// Only odd numbers are sieved, so 2 is never reported.
+class PeSegmentedSieve
+{
+public:
+    // The odd primes up to sqrt(high), which is what a sieve up to <high>
+    // needs for <seeds>. Long lists are sieved in segments too, so this is
+    // quick even for high near 2^64.
+    static std::vector<PeUint> SievingPrimes(PeUint high);
+
+    // Sieve [low, high]. <seeds> must hold the odd primes up to at least
+    // sqrt(high), in increasing order, and must outlive the sieve. Primes
+    // are only used once their squares are reached, so <seeds> may also be
+    // longer than needed, or grow (by appending) between segments.
+    PeSegmentedSieve(PeUint low, PeUint high, const std::vector<PeUint>& seeds,
+                     size_t segment_bytes = kSieveSegmentBytes);
+
+    // Sieve the next segment. Returns false once the whole range is done.
+    bool next();
+
+    // The first and last odd numbers in the whole range
+    PeUint low() const;
+    PeUint high() const;
+
+    // The odd numbers of the current segment are segmentLow(),
+    // segmentLow() + 2, ... segmentHigh()
+    PeUint segmentLow() const;
+    PeUint segmentHigh() const;
+
+    // Number of primes in the current segment
+    size_t count() const;
+
+    // Call visit(p) for each prime p in the current segment, in order
+    template <typename Visitor>
+    void forEachPrime(Visitor visit) const
+    {
+        for ( size_t i_word = 0; i_word < n_words_; ++i_word ) {
+            PeUint       word = words_[i_word];
+            const PeUint base = 2 * (segment_index_ + 64 * i_word) + 1;
+            while ( word != 0 ) {
+                visit(base + 2 * (PeUint)intrinsics::CountTrailingZeros(word));
+                word &= word - 1; // Clear the lowest set bit
+            }
+        }
+    }
+
+    // Private helper functions
+private:
+    // Fill the current segment with the small prime pattern
+    void presieve();
+
+    // Cross off the multiples of the sieving primes
+    void crossOff(PeUint end_index);
+
+    // Members
+private:
+    const std::vector<PeUint>* seeds_;
+
+    // Index (see below) of the next multiple of each sieving prime in use
+    std::vector<PeUint> next_multiple_;
+    size_t              first_seed_;
+
+    // Odd numbers are held by index, i, for the number 2 * i + 1. The
+    // current segment holds indices [segment_index_, segment_end_) and
+    // the range is [begin_index_, end_index_).
+    std::vector<PeUint> words_;
+    size_t              n_words_;
+    PeUint              segment_index_;
+    PeUint              segment_end_;
+    PeUint              begin_index_;
+    PeUint              end_index_;
+}; // class PeSegmentedSieve
+
+// The default limit of a PePrimeIterator, i.e. every prime below 2^64
+const PeUint kNoPrimeLimit = ~PeUint(0);
+
+// Input iterator over the primes in order, from any starting point, with
+// no limit to choose up front. Primes are sieved one segment at a time as
+// iteration reaches them, and the sieving primes are extended as the
+// square root of the current prime grows, so memory use is one segment's
+// primes plus the primes up to a little over sqrt(current), e.g.
+//
+//  PePrimeIterator it(1000000); // The first prime >= 10^6
+//  while ( !isWanted(*it) ) {
+//      ++it;
+//  }
+//  it.skipTo(5000000);          // Jump ahead (or back)
+//
+// A default constructed iterator is the end iterator, which iteration
+// reaches after the last prime up to the limit. Copies share their
+// (unchanging) sieving primes but not their sieves, so each copy can be
+// used independently, though copying costs a segment.
+class PePrimeIterator
+{
+public:
+    typedef std::input_iterator_tag iterator_category;
+    typedef PeUint                  value_type;
+    typedef std::ptrdiff_t          difference_type;
+    typedef const PeUint*           pointer;
+    typedef const PeUint&           reference;
+
+    // The end iterator
+    PePrimeIterator();
+
+    // The primes from the first one >= <start>, up to <limit>
+    explicit PePrimeIterator(PeUint start, PeUint limit = kNoPrimeLimit);
+
+    const PeUint& operator*() const
+    {
+        return buffer_[position_];
+    }
+
+    PePrimeIterator& operator++()
+    {
+        if ( ++position_ == buffer_.size() ) {
+            fill();
+        }
+        return *this;
+    }
+
+    PePrimeIterator operator++(int)
+    {
+        PePrimeIterator previous(*this);
+        ++*this;
+        return previous;
+    }
+
+    // Move to the first prime >= n. Moving forward within the current
+    // segment costs no sieving, anywhere else starts a new sieve at n.
+    void skipTo(PeUint n);
+
+    // Iterators are equal if both are at the end or at the same prime
+    bool operator==(const PePrimeIterator& rhs) const
+    {
+        return done_ ? rhs.done_ : (!rhs.done_ && (**this == *rhs));
+    }
+
+    bool operator!=(const PePrimeIterator& rhs) const
+    {
+        return !operator==(rhs);
+    }
+
+    // Private helper functions
+private:
+    // Start again from the first prime >= start
+    void restart(PeUint start);
+
+    // Start a new sieve after sieved_to_, first extending the sieving
+    // primes if its first segment needs more
+    void startSieve();
+
+    // Sieve segments until one has a prime in it, or the limit is reached
+    void fill();
+
+    // The highest number the next segment can reach
+    PeUint nextHigh() const;
+
+    // Members
+private:
+    PeUint limit_;
+    bool   done_;
+
+    // The odd primes up to seed_root_
+    std::shared_ptr<const std::vector<PeUint>> seeds_;
+    PeUint                                     seed_root_;
+
+    // The sieve has covered every number up to sieved_to_, and the primes
+    // of its current segment are buffered
+    PeSegmentedSieve    sieve_;
+    PeUint              sieved_to_;
+    std::vector<PeUint> buffer_;
+    size_t              position_;
+}; // class PePrimeIterator
+
+// The primes in [low, high], for range based for loops, e.g.
+//
+//  for ( PeUint p: PePrimeRange(1000) ) { // Every prime from 1000 on
+//      if ( ... ) {
+//          break;
+//      }
+//  }
+class PePrimeRange
+{
+public:
+    typedef PePrimeIterator iterator;
+
+    explicit PePrimeRange(PeUint low = 0, PeUint high = kNoPrimeLimit) : low_(low), high_(high) {}
+
+    iterator begin() const
+    {
+        return iterator(low_, high_);
+    }
+
+    iterator end() const
+    {
+        return iterator();
+    }
+
+    // Members
+private:
+    PeUint low_;
+    PeUint high_;
+}; // class PePrimeRange
+
+namespace math
+{
+// Sieving on several threads. The odd numbers up to <limit> are split into
+// chunks of whole segments, and each thread sieves one chunk at a time with
+// its own PeSegmentedSieve, all sharing one list of sieving primes. Each
+// chunk's results are kept apart until every chunk is done, then combined
+// in order, so no locking is needed. A thread count of 0 means the
+// hardware concurrency.
+
+// The primes up to <limit>, in order, as GeneratePrimesEratosthenes()
+std::vector<PeUint> GeneratePrimesParallel(PeUint limit, size_t threads = 0);
+
+// The number of primes up to <limit>, and their sum, without storing them.
+// The sum needs more than 64 bits beyond about 3 * 10^10.
+PeUint    SieveCountPrimes(PeUint limit, size_t threads = 0);
+PeUint128 SieveSumPrimes(PeUint limit, size_t threads = 0);
+}; // namespace math
+
+}; // namespace pe
@@ -0,0 +1,279 @@
+// Copyright 2020-2023 Paul Robertson
+//
+// PeSmallVector.h
+//
+// A vector of trivially copyable values with inline storage for small sizes
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace pe
+{
+// Default allocator policy for PeSmallVector, using the global heap.
+// Allocator policies provide static allocate() and deallocate() functions.
+// allocate() may round the requested size up, returning the usable size in
+// <bytes>; that size is passed back to deallocate().
+struct PeHeapAllocator
+{
+    static void* allocate(size_t& bytes)
+    {
+        void* block = std::malloc(bytes);
+        if ( !block ) {
+            throw std::bad_alloc();
+        }
+
+        return block;
+    }
+
+    static void deallocate(void* block, size_t)
+    {
+        std::free(block);
+    }
+};
+
+// A std::vector-like container holding up to N elements inline, only
+// allocating from the heap once it grows beyond that.
+//
+// This only supports the subset of the std::vector interface needed by the
+// big integer classes, and is restricted to trivially copyable element types
+// so that elements can be moved around with memcpy and never need
+// constructing or destroying.
+//
+// Note that, unlike std::vector, moving a small vector that is using its
+// inline storage copies the elements, and invalidates iterators into the
+// moved-from vector either way.
+//
+// Heap blocks come from the <Allocator> policy, see PeHeapAllocator.
+template <typename T, size_t N, typename Allocator = PeHeapAllocator>
+class PeSmallVector
+{
+    static_assert(std::is_trivially_copyable<T>::value, "PeSmallVector requires a trivially copyable type");
+    static_assert(N > 0, "PeSmallVector requires at least one inline element");
+
+public:
+    typedef T                               value_type;
+    typedef T*                              iterator;
+    typedef const T*                        const_iterator;
+    typedef std::reverse_iterator<T*>       reverse_iterator;
+    typedef std::reverse_iterator<const T*> const_reverse_iterator;
+
+    // Constructors
+    PeSmallVector() : data_(inline_), size_(0), capacity_(N) {}
+
+    explicit PeSmallVector(size_t count, const T& val = T()) : PeSmallVector()
+    {
+        assign(count, val);
+    }
+
+    PeSmallVector(const PeSmallVector& that) : PeSmallVector()
+    {
+        copyFrom(that);
+    }
+
+    PeSmallVector(PeSmallVector&& that) noexcept : PeSmallVector()
+    {
+        moveFrom(that);
+    }
+
+    ~PeSmallVector()
+    {
+        release();
+    }
+
+    // Copy and move assignment operator
+    PeSmallVector& operator=(const PeSmallVector& rhs)
+    {
+        if ( this != &rhs ) {
+            copyFrom(rhs);
+        }
+
+        return *this;
+    }
+
+    PeSmallVector& operator=(PeSmallVector&& rhs) noexcept
+    {
+        if ( this != &rhs ) {
+            release();
+            moveFrom(rhs);
+        }
+
+        return *this;
+    }
+
+    // Element access
+    T&       operator[](size_t i) { return data_[i]; }
+    const T& operator[](size_t i) const { return data_[i]; }
+
+    T&       front() { return data_[0]; }
+    const T& front() const { return data_[0]; }
+    T&       back() { return data_[size_ - 1]; }
+    const T& back() const { return data_[size_ - 1]; }
+
+    T*       data() { return data_; }
+    const T* data() const { return data_; }
+
+    // Iterators
+    iterator       begin() { return data_; }
+    const_iterator begin() const { return data_; }
+    iterator       end() { return data_ + size_; }
+    const_iterator end() const { return data_ + size_; }
+
+    reverse_iterator       rbegin() { return reverse_iterator(end()); }
+    const_reverse_iterator rbegin() const { return const_reverse_iterator(end()); }
+    reverse_iterator       rend() { return reverse_iterator(begin()); }
+    const_reverse_iterator rend() const { return const_reverse_iterator(begin()); }
+
+    // Capacity
+    bool   empty() const { return size_ == 0; }
+    size_t size() const { return size_; }
+    size_t capacity() const { return capacity_; }
+
+    // True if the elements are held in the inline buffer
+    bool isInline() const { return data_ == inline_; }
+
+    void reserve(size_t new_capacity)
+    {
+        if ( new_capacity > capacity_ ) {
+            reallocate(new_capacity);
+        }
+    }
+
+    // Modifiers
+    void clear() { size_ = 0; }
+
+    void push_back(const T& val)
+    {
+        if ( size_ == capacity_ ) {
+            // Copy first in case val refers to one of our own elements
+            T val_copy = val;
+            reallocate(2 * capacity_);
+            data_[size_++] = val_copy;
+        } else {
+            data_[size_++] = val;
+        }
+    }
+
+    void pop_back() { --size_; }
+
+    void resize(size_t count, const T& val = T())
+    {
+        reserve(count);
+        if ( count > size_ ) {
+            std::fill(data_ + size_, data_ + count, val);
+        }
+        size_ = count;
+    }
+
+    void assign(size_t count, const T& val)
+    {
+        reserve(count);
+        std::fill(data_, data_ + count, val);
+        size_ = count;
+    }
+
+    // Insert <count> copies of <val> before <pos>
+    iterator insert(const_iterator pos, size_t count, const T& val)
+    {
+        size_t index    = pos - data_;
+        T      val_copy = val;
+
+        reserve(size_ + count);
+        std::memmove(data_ + index + count, data_ + index, (size_ - index) * sizeof(T));
+        std::fill(data_ + index, data_ + index + count, val_copy);
+        size_ += count;
+
+        return data_ + index;
+    }
+
+    void swap(PeSmallVector& that)
+    {
+        PeSmallVector tmp(std::move(that));
+        that  = std::move(*this);
+        *this = std::move(tmp);
+    }
+
+    // Erase the elements in [first, last)
+    iterator erase(const_iterator first, const_iterator last)
+    {
+        size_t index = first - data_;
+        size_t count = last - first;
+
+        std::memmove(data_ + index, data_ + index + count, (size_ - index - count) * sizeof(T));
+        size_ -= count;
+
+        return data_ + index;
+    }
+
+    // Comparison
+    friend bool operator==(const PeSmallVector& lhs, const PeSmallVector& rhs)
+    {
+        return (lhs.size_ == rhs.size_) && std::equal(lhs.begin(), lhs.end(), rhs.begin());
+    }
+
+    friend bool operator!=(const PeSmallVector& lhs, const PeSmallVector& rhs) { return !(lhs == rhs); }
+
+    // Private helper functions
+private:
+    // Move the elements to a heap buffer of at least <new_capacity> elements
+    void reallocate(size_t new_capacity)
+    {
+        size_t bytes    = new_capacity * sizeof(T);
+        T*     new_data = static_cast<T*>(Allocator::allocate(bytes));
+
+        std::memcpy(new_data, data_, size_ * sizeof(T));
+        release();
+
+        data_     = new_data;
+        capacity_ = bytes / sizeof(T);
+    }
+
+    // Free any heap buffer, returning to the (empty) inline buffer's capacity
+    void release()
+    {
+        if ( !isInline() ) {
+            Allocator::deallocate(data_, capacity_ * sizeof(T));
+            data_     = inline_;
+            capacity_ = N;
+        }
+    }
+
+    void copyFrom(const PeSmallVector& that)
+    {
+        reserve(that.size_);
+        std::memcpy(data_, that.data_, that.size_ * sizeof(T));
+        size_ = that.size_;
+    }
+
+    // Take over that's heap buffer, or copy its inline elements.
+    // This vector must not hold a heap buffer.
+    void moveFrom(PeSmallVector& that)
+    {
+        if ( that.isInline() ) {
+            std::memcpy(inline_, that.inline_, that.size_ * sizeof(T));
+        } else {
+            data_          = that.data_;
+            capacity_      = that.capacity_;
+            that.data_     = that.inline_;
+            that.capacity_ = N;
+        }
+
+        size_      = that.size_;
+        that.size_ = 0;
+    }
+
+    // Members
+private:
+    T*     data_;
+    size_t size_;
+    size_t capacity_;
+    T      inline_[N];
+}; // class PeSmallVector
+}; // namespace pe
@@ -106,7 +106,9 @@ template<typename T> typename std::enable_if<std::is_integral<T>::value, T>::typ
 }
 
 // Generate array of primes up to <limit> using the
-// Sieve of Eratosthenes method
+// Sieve of Eratosthenes method. The sieve is segmented (see PePrimeSieve.h),
+// so memory use beyond the returned array is only O(sqrt(limit)). For primes
+// without a limit chosen up front, see PePrimeIterator.
 std::vector<PeUint> GeneratePrimesEratosthenes(PeUint limit);
 
 // Generate array of primes up to <limit> using the
@@ -165,6 +167,7 @@ std::vector<PeUint> NumberToRadixBuckets(PeUint n, PeUint radix);
 
 // Find the prime factors of <trial_number>
 // Wheel Factorisation method with a basis of (2,3,5).
+// To test primality alone, see IsPrime() in PePrimality.h.
 std::vector<PeUint> PrimeFactors(PeUint trial_number);
 
 // Reverse an integers digits, useful for testing palindromes
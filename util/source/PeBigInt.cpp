@@ -5,64 +5,68 @@
 // A custom arbitrary precision signed integer arithmetic class
 
 #include "PeBigInt.h"
+#include "PeIntrinsics.h"
+
+#include <limits>
+#include <type_traits>
+#include <utility>
 
 namespace pe
 {
 
-// Static constant regex for value string matching
-// Using optimize flag to give matching slightly more speed
-const std::regex PeBigInt::kValueStringRe = std::regex("([-+])?([0-9]+)([eE][0-9]+)?", std::regex::optimize);
-
-PeBigInt::PeBigInt() : sign_(1) {}
+PeBigInt::PeBigInt() : sign_(1), offset_(0) {}
 
 // Copy and move constructors
-PeBigInt::PeBigInt(const PeBigInt& that) : sign_(that.sign_), digits_(that.digits_) {}
+PeBigInt::PeBigInt(const PeBigInt& that) : sign_(that.sign_), digits_(that.digits_), offset_(that.offset_) {}
 
-PeBigInt::PeBigInt(PeBigInt&& that) noexcept : sign_(that.sign_), digits_(move(that.digits_)) {}
+PeBigInt::PeBigInt(PeBigInt&& that) noexcept :
+    sign_(that.sign_), digits_(std::move(that.digits_)), offset_(that.offset_)
+{
+}
 
 // Constructors from integer types
-PeBigInt::PeBigInt(int val) : sign_(1)
+PeBigInt::PeBigInt(int val) : sign_(1), offset_(0)
 {
     fromSigned(val);
 }
 
-PeBigInt::PeBigInt(long int val) : sign_(1)
+PeBigInt::PeBigInt(long int val) : sign_(1), offset_(0)
 {
     fromSigned(val);
 }
 
-PeBigInt::PeBigInt(PeInt val) : sign_(1)
+PeBigInt::PeBigInt(PeInt val) : sign_(1), offset_(0)
 {
     fromSigned(val);
 }
 
-PeBigInt::PeBigInt(unsigned val) : sign_(1)
+PeBigInt::PeBigInt(unsigned val) : sign_(1), offset_(0)
 {
     fromUnsigned(val);
 }
 
-PeBigInt::PeBigInt(long unsigned val) : sign_(1)
+PeBigInt::PeBigInt(long unsigned val) : sign_(1), offset_(0)
 {
     fromUnsigned(val);
 }
 
-PeBigInt::PeBigInt(PeUint val) : sign_(1)
+PeBigInt::PeBigInt(PeUint val) : sign_(1), offset_(0)
 {
     fromUnsigned(val);
 }
 
 // Constructors from floating point types
-PeBigInt::PeBigInt(float val) : sign_(1)
+PeBigInt::PeBigInt(float val) : sign_(1), offset_(0)
 {
     fromFloating(val);
 }
 
-PeBigInt::PeBigInt(double val) : sign_(1)
+PeBigInt::PeBigInt(double val) : sign_(1), offset_(0)
 {
     fromFloating(val);
 }
 
-PeBigInt::PeBigInt(long double val) : sign_(1)
+PeBigInt::PeBigInt(long double val) : sign_(1), offset_(0)
 {
     fromFloating(val);
 }
@@ -70,12 +74,12 @@ PeBigInt::PeBigInt(long double val) : sign_(1)
 // String constructors
 // These take a numeric string and create an
 // appropriate integer representation
-PeBigInt::PeBigInt(const char* valstr) : sign_(1)
+PeBigInt::PeBigInt(const char* valstr) : sign_(1), offset_(0)
 {
     fromString(valstr);
 }
 
-PeBigInt::PeBigInt(const std::string& valstr) : sign_(1)
+PeBigInt::PeBigInt(const std::string& valstr) : sign_(1), offset_(0)
 {
     fromString(valstr);
 }
@@ -92,6 +96,7 @@ PeBigInt& PeBigInt::operator=(const PeBigInt& rhs)
 
     sign_   = rhs.sign_;
     digits_ = rhs.digits_;
+    offset_ = rhs.offset_;
 
     return *this;
 }
@@ -104,7 +109,8 @@ PeBigInt& PeBigInt::operator=(PeBigInt&& rhs) noexcept
     }
 
     sign_   = rhs.sign_;
-    digits_ = move(rhs.digits_);
+    digits_ = std::move(rhs.digits_);
+    offset_ = rhs.offset_;
 
     return *this;
 }
@@ -195,7 +201,8 @@ PeBigInt& PeBigInt::operator+=(const PeBigInt& rhs)
             // digits to this.
             PeBigInt rhs_copy(rhs);
             rhs_copy.absMinusEq(*this);
-            digits_ = move(rhs_copy.digits_);
+            digits_ = std::move(rhs_copy.digits_);
+            offset_ = rhs_copy.offset_;
             sign_   = rhs_copy.sign_;
         } else {
             // If this absolute value is larger,
@@ -237,6 +244,16 @@ PeBigInt& PeBigInt::operator/=(const PeBigInt& rhs)
     return *this;
 }
 
+PeBigInt& PeBigInt::operator%=(const PeBigInt& rhs)
+{
+    // Keep the remainder and discard the quotient
+    PeBigInt remainder;
+    divmod(rhs, remainder);
+    *this = std::move(remainder);
+
+    return *this;
+}
+
 // Conversion operators
 // Values that are too large for the data type
 // will be converted to the maximum value for
@@ -249,57 +266,39 @@ PeBigInt::operator PeInt() const
     // from the power of 2 since we only support the positive "half" of PeInt range
     size_t digitsize = (size_t)floor((double)(8 * sizeof(PeInt) - 1) * log10(2.0));
 
-    // Too large, return maximum possible value
-    if ( digits_.size() * kBasePower > digitsize ) {
+    // Too large, return maximum possible value. Limbs hold kBasePower digits
+    // so a value with one more digit than digitsize can still need one more
+    // limb than digitsize / kBasePower.
+    const size_t n_limbs = digits_.size() + offset_;
+    if ( n_limbs > digitsize / kBasePower + 1 ) {
         return sign_ > 0 ? INTMAX_MAX : INTMAX_MIN; // Standard requires at least 64 bit
     }
 
     // Definitely small enough, we can do a direct conversion
-    if ( digits_.size() * kBasePower < digitsize ) {
-        PeInt sum = 0, base_mul = 1;
-
-        for ( const auto& ai: digits_ ) {
-            sum += base_mul * (PeInt)ai;
-
-            // This can overflow on the last loop but
-            // won't be used after that so don't worry
-            base_mul *= (PeInt)kBase;
-        }
+    if ( n_limbs * kBasePower <= digitsize ) {
+        // Sum the magnitude unsigned, since INTMAX_MIN's magnitude
+        // doesn't fit in a PeInt
+        const PeUint sum = absToUnsigned();
 
         // Update the sign
-        if ( sign_ < 0 ) {
-            sum = -sum;
-        }
-
-        return sum;
+        return sign_ < 0 ? (PeInt)(0 - sum) : (PeInt)sum;
     }
 
-    // digits_.size() * kBasePower == bitsize, we might be ok but we need to
-    // do a more exact check. Putting this last to avoid the extra cost of
-    // checking against PeBigInt conversions of INTMAX_MAX and INTMAX_MIN if
-    // we don't have to.
+    // In the top limb, we might be ok but we need to do a more exact check.
+    // Putting this last to avoid the extra cost of checking against PeBigInt
+    // conversions of INTMAX_MAX and INTMAX_MIN if we don't have to.
 
     if ( *this > PeBigInt(INTMAX_MAX) ) {
         return INTMAX_MAX;
     } else if ( *this < PeBigInt(INTMAX_MIN) ) {
         return INTMAX_MIN;
     } else {
-        PeInt sum = 0, base_mul = 1;
-
-        for ( const auto& ai: digits_ ) {
-            sum += base_mul * (PeInt)ai;
-
-            // This can overflow on the last loop but
-            // won't be used after that so don't worry
-            base_mul *= (PeInt)kBase;
-        }
+        // Sum the magnitude unsigned, since INTMAX_MIN's magnitude
+        // doesn't fit in a PeInt
+        const PeUint sum = absToUnsigned();
 
         // Update the sign
-        if ( sign_ < 0 ) {
-            sum = -sum;
-        }
-
-        return sum;
+        return sign_ < 0 ? (PeInt)(0 - sum) : (PeInt)sum;
     }
 }
 
@@ -313,44 +312,25 @@ PeBigInt::operator PeUint() const
     // Work out longest decimal size supported
     size_t digitsize = (size_t)floor((double)(8 * sizeof(PeUint)) * log10(2.0));
 
-    // Too large, return maximum possible value
-    if ( digits_.size() * kBasePower > digitsize ) {
+    // Too large, return maximum possible value (see operator PeInt)
+    const size_t n_limbs = digits_.size() + offset_;
+    if ( n_limbs > digitsize / kBasePower + 1 ) {
         return UINTMAX_MAX; // Standard requires at least 64 bit
     }
 
     // Definitely small enough, we can do a direct conversion
-    if ( digits_.size() * kBasePower < digitsize ) {
-        PeUint sum = 0, base_mul = 1;
-
-        for ( const auto& ai: digits_ ) {
-            sum += base_mul * (PeUint)ai;
-
-            // This can overflow on the last loop but
-            // won't be used after that so don't worry
-            base_mul *= (PeUint)kBase;
-        }
-
-        return sum;
+    if ( n_limbs * kBasePower <= digitsize ) {
+        return absToUnsigned();
     }
 
-    // digits_.size() * kBasePower == bitsize, we might be ok but we need to
-    // do a more exact check. Putting this last to avoid the extra cost of
-    // checking against PeBigInt conversions of UINTMAX_MAX we don't have to.
+    // In the top limb, we might be ok but we need to do a more exact check.
+    // Putting this last to avoid the extra cost of checking against PeBigInt
+    // conversions of UINTMAX_MAX we don't have to.
 
     if ( *this > PeBigInt(UINTMAX_MAX) ) {
         return UINTMAX_MAX;
     } else {
-        PeUint sum = 0, base_mul = 1;
-
-        for ( const auto& ai: digits_ ) {
-            sum += base_mul * (PeUint)ai;
-
-            // This can overflow on the last loop but
-            // won't be used after that so don't worry
-            base_mul *= (PeUint)kBase;
-        }
-
-        return sum;
+        return absToUnsigned();
     }
 }
 
@@ -360,13 +340,15 @@ PeBigInt::operator long double() const
     // Quick check for size overflow:
     // Is this number's potential exponent bigger than
     // long double allows?
-    if ( digits_.size() * kBasePower > LDBL_MAX_10_EXP ) {
+    const size_t n_limbs = digits_.size() + offset_;
+    if ( n_limbs * kBasePower > LDBL_MAX_10_EXP ) {
         return LDBL_MAX;
     }
 
     // If this didn't return above, the number might still be
-    // too big, do a more fine-grained check
-    if ( *this > PeBigInt(LDBL_MAX) ) {
+    // too big if it's within a limb of the limit, so do a more
+    // fine-grained check
+    if ( (n_limbs * kBasePower + kBasePower > LDBL_MAX_10_EXP) && (*this > PeBigInt(LDBL_MAX)) ) {
         return LDBL_MAX;
     }
 
@@ -374,6 +356,10 @@ PeBigInt::operator long double() const
     // represented by a long double
     long double sum = 0.0, base_mul = 1.0;
 
+    for ( size_t i = 0; i < offset_; ++i ) {
+        base_mul *= (long double)kBase;
+    }
+
     for ( const auto& ai: digits_ ) {
         sum += base_mul * (long double)ai;
 
@@ -393,99 +379,230 @@ PeBigInt::operator long double() const
 // Conversion to string
 PeBigInt::operator std::string() const
 {
+    std::string str(toCharsSize(), '\0');
+    str.resize(toChars(&str[0]));
+
+    return str;
+}
+
+// Write this number's decimal representation to <buffer>, which must have
+// room for at least toCharsSize() characters. No null terminator is written.
+// Returns the number of characters written.
+size_t PeBigInt::toChars(char* buffer) const
+{
+    char* out = buffer;
+
     // Zero check
     if ( isZero() ) {
-        return std::string("0");
+        *out = '0';
+        return 1;
     }
 
-    std::ostringstream ss;
-
     // Write sign if negative
     if ( sign_ < 0 ) {
-        ss << "-";
+        *out++ = '-';
     }
 
-    // Write most significant digit "as normal"
-    ss << digits_.back();
+    // Write most significant limb without zero padding
+    char top_digits[kBasePower];
+    limbs::FormatLimb(digits_.back(), top_digits);
+
+    size_t first_digit = 0;
+    while ( (first_digit + 1 < kBasePower) && (top_digits[first_digit] == '0') ) {
+        ++first_digit;
+    }
+
+    for ( size_t i = first_digit; i < kBasePower; ++i ) {
+        *out++ = top_digits[i];
+    }
 
-    // Write remaining digits with zero padding
-    auto i_digit = digits_.rbegin() + 1;
-    for ( ; i_digit != digits_.rend(); ++i_digit ) {
-        ss << std::setfill('0') << std::setw(kBasePower) << *i_digit;
+    // Write remaining limbs with zero padding
+    for ( auto i_digit = digits_.rbegin() + 1; i_digit != digits_.rend(); ++i_digit ) {
+        limbs::FormatLimb(*i_digit, out);
+        out += kBasePower;
     }
 
-    return ss.str();
+    // Then the offset's zero limbs
+    std::fill(out, out + offset_ * kBasePower, '0');
+    out += offset_ * kBasePower;
+
+    return out - buffer;
 }
 
-// Helper functions for operator overloading.
-// These typically work with the absolute value
-// of the number.
+// Upper bound on the characters written by toChars()
+size_t PeBigInt::toCharsSize() const
+{
+    return (sign_ < 0 ? 1 : 0) + kBasePower * (std::max<size_t>(digits_.size(), 1) + offset_);
+}
 
-// Comparison
-bool PeBigInt::absEq(const PeBigInt& rhs) const
+// Divide this number by rhs, leaving the quotient in this number and
+// storing the remainder in <remainder>.
+// The quotient is truncated towards zero and the remainder takes the
+// sign of the dividend, matching the behaviour of built in integers.
+// Throws runtime_error if rhs is zero.
+PeBigInt& PeBigInt::divmod(const PeBigInt& rhs, PeBigInt& remainder)
 {
-    // If number of digits doesn't match then they aren't equal
-    if ( digits_.size() != rhs.digits_.size() ) {
-        return false;
+    // Record signs first in case rhs and remainder are the same object
+    int numerator_sign   = sign_;
+    int denominator_sign = rhs.sign_;
+
+    // Do division of absolute values, keeping the remainder
+    absDivModEq(rhs, &remainder);
+
+    // Multiply signs for the quotient, remainder follows the numerator
+    sign_           = numerator_sign * denominator_sign;
+    remainder.sign_ = remainder.isZero() ? 1 : numerator_sign;
+
+    return *this;
+}
+
+// Small operand arithmetic
+
+PeBigInt& PeBigInt::mulSmall(PeInt k)
+{
+    if ( (k <= -(PeInt)kBase) || (k >= (PeInt)kBase) ) {
+        return operator*=(PeBigInt(k));
     }
 
-    // Same number of digits, check digit-by-digit from
-    // most to least significant and return false if any
-    // inequality is found
-    for ( auto ithis = digits_.rbegin(), irhs = rhs.digits_.rbegin(); ithis != digits_.rend(); ++ithis, ++irhs ) {
-        if ( *ithis != *irhs )
-            return false;
+    // The product has at most one more limb, written over this number's
+    const size_t length = digits_.size();
+    digits_.push_back(0);
+    limbs::MultiplySmall(digits_.data(), length, (PeUint)(k < 0 ? -k : k), digits_.data());
+
+    if ( k < 0 ) {
+        sign_ = -sign_;
     }
+    normalise();
 
-    // If we've made it here then the two digits should be equal
-    return true;
+    return *this;
 }
 
-bool PeBigInt::absLt(const PeBigInt& rhs) const
+PeBigInt& PeBigInt::addSmall(PeInt k)
 {
-    // Rhs has more digits, therefore rhs is bigger
-    if ( digits_.size() < rhs.digits_.size() ) {
-        return true;
+    // k fits in the inline limbs, so this doesn't allocate
+    return fma(PeBigInt(k), 1);
+}
+
+// When x * k has the same sign as this number, the magnitudes are added.
+// Otherwise x * k is subtracted from this number's magnitude, and if it was
+// the larger the difference is negated and the sign flipped.
+PeBigInt& PeBigInt::fma(const PeBigInt& x, PeInt k)
+{
+    if ( (k <= -(PeInt)kBase) || (k >= (PeInt)kBase) ) {
+        PeBigInt product(x);
+        return operator+=(product.mulSmall(k));
     }
 
-    // This has more digits, therefore this is bigger
-    if ( digits_.size() > rhs.digits_.size() ) {
-        return false;
+    if ( (k == 0) || x.isZero() ) {
+        return *this;
     }
 
-    // Same number of digits, check digit-by-digit from
-    // most to least significant and return as soon as an
-    // inequality is found
-    for ( auto ithis = digits_.rbegin(), irhs = rhs.digits_.rbegin(); ithis != digits_.rend(); ++ithis, ++irhs ) {
-        if ( *ithis < *irhs )
-            return true;
-        if ( *ithis > *irhs )
-            return false;
+    const PeUint multiplier = (PeUint)(k < 0 ? -k : k);
+    const int    term_sign  = k < 0 ? -x.sign_ : x.sign_;
+    const size_t x_length   = x.digits_.size(); // Read before any resize, as x may be this number
+    const size_t x_offset   = x.offset_;
+
+    if ( isZero() ) {
+        sign_   = term_sign;
+        offset_ = x_offset;
     }
 
-    // If we reach here, the values are equal
-    return false;
+    // Line up the lower offset, so x * k starts <position> limbs up
+    reduceOffset(std::min(offset_, x_offset));
+    const size_t position = x_offset - offset_;
+
+    if ( sign_ == term_sign ) {
+        // Room for the product's extra limb and a carry
+        digits_.resize(std::max(digits_.size(), position + x_length + 1) + 1, 0);
+        limbs::MultiplySmallAddTo(digits_.data() + position, digits_.size() - position, x.digits_.data(), x_length,
+                                  multiplier);
+    } else {
+        // If x * k is the larger, the limbs below <position> are part of
+        // what's negated
+        digits_.resize(std::max(digits_.size(), position + x_length + 1), 0);
+        if ( limbs::MultiplySmallSubtractFrom(digits_.data() + position, digits_.size() - position,
+                                              x.digits_.data(), x_length, multiplier) ) {
+            limbs::Negate(digits_.data(), digits_.size());
+            sign_ = -sign_;
+        }
+    }
+
+    normalise();
+
+    return *this;
+}
+
+// Throws runtime_error if d is zero.
+PeInt PeBigInt::divSmall(PeInt d)
+{
+    if ( d == 0 ) {
+        throw std::runtime_error("PeBigInt: Division by zero.");
+    }
+
+    if ( (d <= -(PeInt)kBase) || (d >= (PeInt)kBase) ) {
+        PeBigInt remainder;
+        divmod(PeBigInt(d), remainder);
+        return (PeInt)remainder;
+    }
+
+    const PeInt remainder = (PeInt)absShortDivEq((PeUint)(d < 0 ? -d : d)) * sign_;
+
+    if ( d < 0 ) {
+        sign_ = -sign_;
+    }
+    normalise();
+
+    return remainder;
+}
+
+// Helper functions for operator overloading.
+// These typically work with the absolute value
+// of the number.
+
+// Comparison
+// These use the limb comparison kernels, which compare several limbs at
+// once from the most significant end.
+bool PeBigInt::absEq(const PeBigInt& rhs) const
+{
+    return limbs::CompareOffset(digits_.data(), digits_.size(), offset_, rhs.digits_.data(), rhs.digits_.size(),
+                                rhs.offset_) == 0;
+}
+
+bool PeBigInt::absLt(const PeBigInt& rhs) const
+{
+    return limbs::CompareOffset(digits_.data(), digits_.size(), offset_, rhs.digits_.data(), rhs.digits_.size(),
+                                rhs.offset_) < 0;
 }
 
 // Arithmetic
+// Addition and subtraction line up the operands' offsets at the lower of
+// the two, then work on the limbs from the other's offset up
 PeBigInt& PeBigInt::absPlusEq(const PeBigInt& rhs)
 {
-    PeUint carry = 0;
+    if ( rhs.isZero() ) {
+        return *this;
+    }
 
-    // Loop over digits up to size of large number, with an extra loop if carry occurs
-    for ( size_t i = 0; i < std::max(digits_.size(), rhs.digits_.size()) || carry; ++i ) {
-        // Extend this number if we're past its size
-        if ( i == digits_.size() ) {
-            digits_.push_back(0);
-        }
+    if ( isZero() ) {
+        digits_ = rhs.digits_;
+        offset_ = rhs.offset_;
+        return *this;
+    }
 
-        digits_[i] += carry + (i < rhs.digits_.size() ? rhs.digits_[i] : 0);
+    // Make room for the longer number plus a carry limb.
+    // Note rhs may be this number, so its size is read first.
+    const size_t rhs_size = rhs.digits_.size();
+    reduceOffset(std::min(offset_, rhs.offset_));
 
-        // Carry check
-        carry = digits_[i] >= kBase;
-        if ( carry ) {
-            digits_[i] -= kBase;
-        }
+    const size_t position = rhs.offset_ - offset_;
+    const size_t length   = std::max(digits_.size(), position + rhs_size) + 1;
+    digits_.resize(length, 0);
+
+    limbs::AddTo(digits_.data() + position, length - position, rhs.digits_.data(), rhs_size);
+
+    // Drop the carry limb if it wasn't needed
+    while ( digits_.size() > 1 && digits_.back() == 0 ) {
+        digits_.pop_back();
     }
 
     return *this;
@@ -495,43 +612,39 @@ PeBigInt& PeBigInt::absPlusEq(const PeBigInt& rhs)
 // behaviour occurs
 PeBigInt& PeBigInt::absMinusEq(const PeBigInt& rhs)
 {
-    PeUint carry = 0;
+    if ( rhs.isZero() ) {
+        return *this;
+    }
 
-    // Loop over rhs digits, or until carry occurs
-    for ( size_t i = 0; i < rhs.digits_.size() || carry; ++i ) {
-        digits_[i] -= carry + (i < rhs.digits_.size() ? rhs.digits_[i] : 0);
+    reduceOffset(std::min(offset_, rhs.offset_));
 
-        // Carry check
-        carry = digits_[i] < 0 ? 1 : 0;
-        if ( carry ) {
-            digits_[i] += kBase;
-        }
-    }
+    const size_t position = rhs.offset_ - offset_;
+    limbs::SubtractFrom(digits_.data() + position, digits_.size() - position, rhs.digits_.data(),
+                        rhs.digits_.size());
 
     // Clear any leading zeros
     while ( digits_.size() > 1 && digits_.back() == 0 ) {
         digits_.pop_back();
     }
 
+    if ( isZero() ) {
+        offset_ = 0;
+    }
+
     return *this;
 }
 
+// Only the stored limbs are multiplied; the offsets add
 PeBigInt& PeBigInt::absMultEq(const PeBigInt& rhs)
 {
-    // Result digits
-    std::vector<PeUint> res(digits_.size() + rhs.digits_.size(), 0);
+    const size_t rhs_offset = rhs.offset_;
 
-    PeUint carry = 0;
-    // Outer loop over this numbers digits
-    for ( size_t i = 0; i < digits_.size(); ++i ) {
-        // Inner loop over rhs digits with extra pass if carry occurs
-        for ( size_t j = 0; (j < rhs.digits_.size()) || carry; ++j ) {
-            PeInt cur = res[i + j] + digits_[i] * (j < rhs.digits_.size() ? rhs.digits_[j] : 0) + carry;
+    // Result digits
+    LimbVector res(digits_.size() + rhs.digits_.size(), 0);
 
-            res[i + j] = cur % kBase;
-            carry      = cur / kBase; // Integer division
-        }
-    }
+    // Size dispatched multiplication (schoolbook, Karatsuba or Toom-3).
+    // The result is written to a separate array, so rhs may alias this.
+    limbs::Multiply(digits_.data(), digits_.size(), rhs.digits_.data(), rhs.digits_.size(), res.data());
 
     // Clear any leading zeros
     while ( (res.size() > 1) && (res.back() == 0) ) {
@@ -539,89 +652,90 @@ PeBigInt& PeBigInt::absMultEq(const PeBigInt& rhs)
     }
 
     // Move result to this
-    digits_ = move(res);
+    digits_ = std::move(res);
+    offset_ = isZero() ? 0 : offset_ + rhs_offset;
 
     return *this;
 }
 
-// This function is slower than the other arithmetic operators.
 // Throws runtime_error if rhs is zero.
 PeBigInt& PeBigInt::absDivEq(const PeBigInt& rhs)
+{
+    return absDivModEq(rhs, nullptr);
+}
+
+// Long division of absolute values using Algorithm D, or Newton division
+// for very large numbers.
+// Throws runtime_error if rhs is zero.
+PeBigInt& PeBigInt::absDivModEq(const PeBigInt& rhs, PeBigInt* remainder)
 {
     // Divison by zero check
     if ( rhs.isZero() ) {
         throw std::runtime_error("PeBigInt: Division by zero.");
     }
 
-    // Quick check for same abs value:
-    // just set this value to 1.
-    if ( absEq(rhs) ) {
-        digits_ = std::vector<PeUint>({ 1 });
-    } else if ( absLt(rhs) ) {
-        digits_ = std::vector<PeUint>({ 0 });
-    } else {
-        // Copy this and rhs and set signs to positive
-        PeBigInt numerator(*this);
+    // The division kernels need every limb stored
+    if ( rhs.offset_ > 0 ) {
         PeBigInt denominator(rhs);
-        numerator.sign_   = 1;
-        denominator.sign_ = 1;
-
-        // Record the lengths of the numerator and denominator as integers
-        int denominator_length = (int)(denominator.digits_.size());
-
-        // The "quick denominator" is the leading digit of the denominator
-        PeUint quick_d = denominator.digits_.back();
-
-        // Initialise the quotient as numerator / a
-        PeBigInt quotient(numerator);
-        quotient.absShortDivEq(quick_d);
-
-        // We actually want this to be "a000..." where
-        // a000... is the same length as the denominator,
-        // so we radix shift the quotient to account for
-        // quick_d being < kBase
-        quotient.radixShift(1 - denominator_length);
-
-        PeBigInt remainder = denominator + PeBigInt(1);
-        PeBigInt quotient_new;
-        while ( !remainder.absLt(denominator) ) {
-            remainder    = numerator - quotient * denominator;
-            quotient_new = remainder;
-            quotient_new.absShortDivEq(quick_d);
-            quotient_new.radixShift(1 - denominator_length);
-            quotient_new += quotient;
-            quotient += quotient_new;
-            quotient.absShortDivEq(2);
+        denominator.reduceOffset(0);
+        return absDivModEq(denominator, remainder);
+    }
+
+    // Quick check for a smaller numerator:
+    // the quotient is zero and the remainder is this value
+    if ( absLt(rhs) ) {
+        if ( remainder ) {
+            remainder->digits_ = digits_;
+            remainder->offset_ = offset_;
+            remainder->sign_   = 1;
         }
+        digits_.assign(1, 0);
+        offset_ = 0;
+    } else {
+        reduceOffset(0);
+
+        size_t numerator_length   = digits_.size();
+        size_t denominator_length = rhs.digits_.size();
+
+        // The division writes to separate arrays, so rhs may alias this
+        LimbVector quotient(numerator_length - denominator_length + 1);
+        LimbVector remainder_digits(remainder ? denominator_length : 0);
+
+        limbs::Divide(digits_.data(), numerator_length, rhs.digits_.data(), denominator_length, quotient.data(),
+                      remainder ? remainder_digits.data() : nullptr);
+
+        // Clear any leading zeros
+        while ( (quotient.size() > 1) && (quotient.back() == 0) ) {
+            quotient.pop_back();
+        }
+
+        if ( remainder ) {
+            while ( (remainder_digits.size() > 1) && (remainder_digits.back() == 0) ) {
+                remainder_digits.pop_back();
+            }
 
-        remainder = numerator - quotient * denominator; // Calculate a final value for R
-        if ( remainder.sign_ < 0 ) {
-            quotient -= PeBigInt(1);
-            remainder += denominator;
+            remainder->digits_ = std::move(remainder_digits);
+            remainder->offset_ = 0;
+            remainder->sign_   = 1;
         }
 
-        digits_ = quotient.digits_;
+        digits_ = std::move(quotient);
     }
 
     return *this;
 }
 
-// Divide by a denominator less than kBase
+// Divide by a denominator less than kBase, returning the remainder
 // Note this doesn't check
-PeBigInt& PeBigInt::absShortDivEq(PeInt denominator)
+PeUint PeBigInt::absShortDivEq(PeUint denominator)
 {
-    PeUint carry = 0;
+    reduceOffset(0);
 
-    // Loop over this number's digits in reverse order
-    for ( auto i = digits_.rbegin(); i != digits_.rend(); ++i ) {
-        PeUint cur = *i + carry * kBase;
-        *i         = cur / denominator;
-        carry      = cur % denominator;
-    }
+    PeUint remainder = limbs::DivideSmall(digits_.data(), digits_.size(), denominator);
 
     popLeadingZeros();
 
-    return *this;
+    return remainder;
 }
 
 // Helper functions for conversion from numeric types
@@ -649,7 +763,10 @@ void PeBigInt::fromSigned(PeInt val)
     // Check for negative
     if ( val < 0 ) {
         sign_ = -1;
-        val   = -val; // Flip sign to allow unsigned conversion
+
+        // Negate as unsigned, which also works for INTMAX_MIN
+        fromUnsigned(0 - (PeUint)val);
+        return;
     }
 
     // Convert the unsigned value
@@ -665,7 +782,7 @@ void PeBigInt::fromUnsigned(PeUint val)
     digits_.push_back(val);
 }
 
-// String must match the regex [-+]?[0-9]+([eE][0-9]+)?
+// String must be of the form [-+]?[0-9]+([eE][0-9]+)?
 // i.e. leading sign optional, whole number, optional positive exponent.
 // Invalid strings will be ignored and the value will be initialised to zero.
 //
@@ -686,46 +803,89 @@ void PeBigInt::fromUnsigned(PeUint val)
 // Can you allocate a std::vector of 4 billion digits? Possibly. Will you get any
 // reasonable performance from this class for a number that large? Unlikely.
 // You probably need to look elsewhere for that kind of speedy math.
+//
+// The string is scanned by hand rather than with a regex: the digit runs are
+// validated 16 characters at a time and converted one limb (8 digits) at a
+// time, working back from the least significant end.
 void PeBigInt::fromString(const std::string& valstr)
 {
-    // Check that initialiser string matches
-    std::smatch value_match;
+    const char*  str    = valstr.data();
+    const size_t length = valstr.size();
+    size_t       pos    = 0;
+    int          sign   = 1;
+
+    // Optional sign
+    if ( (length > 0) && ((str[0] == '-') || (str[0] == '+')) ) {
+        sign = str[0] == '-' ? -1 : 1;
+        ++pos;
+    }
 
-    if ( std::regex_match(valstr, value_match, kValueStringRe) ) {
-        std::string strbase;
-        PeUint      exp_value = 0;
+    // The mantissa runs to an exponent marker or the end of the string
+    const size_t mantissa_start = pos;
+    size_t       mantissa_end   = valstr.find_first_of("eE", pos);
+    bool         has_exponent   = mantissa_end != std::string::npos;
 
-        // Sign match
-        // Positive is the default so we only need to take action for a negative
-        if ( value_match[1].matched ) {
-            if ( value_match[1].str() == "-" ) {
-                sign_ = -1;
-            }
-        }
+    if ( !has_exponent ) {
+        mantissa_end = length;
+    }
 
-        // Value match
-        if ( value_match[2].matched ) {
-            strbase = value_match[2].str();
-        }
+    const size_t exponent_start = has_exponent ? mantissa_end + 1 : length;
+
+    // Validate both digit runs
+    bool is_valid = (mantissa_end > mantissa_start) &&
+                    limbs::AllDigits(str + mantissa_start, mantissa_end - mantissa_start) &&
+                    (!has_exponent ||
+                     ((exponent_start < length) && limbs::AllDigits(str + exponent_start, length - exponent_start)));
+
+    // Invalid initialiser string, set to zero and return
+    if ( !is_valid ) {
+        digits_.push_back(0);
+        return;
+    }
+
+    // Initialise base value, full limbs from the end of the mantissa
+    size_t i = mantissa_end;
+    digits_.reserve((mantissa_end - mantissa_start) / kBasePower + 1);
+
+    for ( ; i - mantissa_start > kBasePower; i -= kBasePower ) {
+        digits_.push_back(limbs::ParseLimb(str + i - kBasePower));
+    }
+
+    // Remaining (most significant) 1 to 8 digits
+    PeUint top_limb = 0;
+    for ( size_t j = mantissa_start; j < i; ++j ) {
+        top_limb = 10 * top_limb + (PeUint)(str[j] - '0');
+    }
+    digits_.push_back(top_limb);
+
+    // Clear any leading zeros
+    while ( (digits_.size() > 1) && (digits_.back() == 0) ) {
+        digits_.pop_back();
+    }
+
+    // Apply exponent: whole limbs as a radix shift, the remaining
+    // power of ten (less than kBase) as a single limb multiplication
+    if ( has_exponent && !isZero() ) {
+        PeUint exp_value = std::stoull(valstr.substr(exponent_start));
 
-        // Exponent match
-        if ( value_match[3].matched ) {
-            // Note +1 to chop off "e" at start of match
-            exp_value = std::stoull(std::string(value_match[3].first + 1, value_match[3].second));
+        PeUint scale = 1;
+        for ( PeUint k = 0; k < exp_value % kBasePower; ++k ) {
+            scale *= 10;
         }
 
-        // Initialise base value
-        PeUint i = (PeUint)strbase.length();
-        for ( ; i > kBasePower; i -= kBasePower ) {
-            digits_.push_back(stoull(strbase.substr(i - kBasePower, kBasePower)));
+        if ( scale > 1 ) {
+            size_t n = digits_.size();
+            digits_.push_back(0);
+            limbs::MultiplySmall(digits_.data(), n, scale, digits_.data());
+            popLeadingZeros();
         }
-        digits_.push_back(stoull(strbase.substr(0, i)));
 
-        // Apply exponent as radix shift
-        radixShift(exp_value);
+        radixShift((PeInt)(exp_value / kBasePower));
+    }
 
-    } else { // Invalid initialiser string, set to zero and return
-        digits_.push_back(0);
+    // Zero is kept positive
+    if ( !isZero() ) {
+        sign_ = sign;
     }
 }
 
@@ -744,114 +904,1017 @@ void PeBigInt::popLeadingZeros()
     while ( (digits_.size() > 0) && (digits_.back() == 0) ) {
         digits_.pop_back();
     }
+
+    if ( digits_.empty() ) {
+        offset_ = 0;
+    }
 }
 
-PeBigInt& PeBigInt::power(PeUint exponent)
+void PeBigInt::normalise()
 {
-    // Only act on positive exponents
-    if ( exponent > 0 ) {
-        PeBigInt tmp_val(1);
+    while ( (digits_.size() > 1) && (digits_.back() == 0) ) {
+        digits_.pop_back();
+    }
 
-        // Square this number and halve the exponent until exponent is zero
-        while ( exponent > 1 ) {
-            if ( math::IsOdd(exponent) ) {
-                // If exponent is odd, accumuluate a multiplication in
-                // tmp_val before squaring
-                tmp_val *= *this;
-            }
+    if ( isZero() ) {
+        sign_   = 1;
+        offset_ = 0;
+    }
+}
 
-            // Square current number and halve exponent
-            square();
-            exponent /= 2; // Integer division
-        }
+void PeBigInt::reduceOffset(size_t offset)
+{
+    if ( offset_ > offset ) {
+        digits_.insert(digits_.begin(), offset_ - offset, 0);
+        offset_ = offset;
+    }
+}
 
-        // Accumulate any "odd division" steps from above
-        operator*=(tmp_val);
+PeUint PeBigInt::absToUnsigned() const
+{
+    PeUint sum = 0, base_mul = 1;
+
+    for ( size_t i = 0; i < offset_; ++i ) {
+        base_mul *= kBase;
     }
 
-    return *this;
+    for ( const auto& ai: digits_ ) {
+        sum += base_mul * ai;
+
+        // This can overflow on the last loop but
+        // won't be used after that so don't worry
+        base_mul *= kBase;
+    }
+
+    return sum;
 }
 
-// Radix shift function, equivalent to multiplying/dividing by kBase^n
-// Analogous to << and >> operators in binary
-// Positive n gives left shift (std::multiplies), negative n gives right shift (divides)
-PeBigInt& PeBigInt::radixShift(PeInt n)
+namespace
 {
-    // Right shift of more than digit size sets number to zero
-    if ( (PeInt)digits_.size() + n <= 0 ) {
-        digits_.clear();
-        digits_.push_back(0);
-        return *this;
+// Test whether the limbs <digits> hold a power of ten, 10^n, setting <n>
+bool IsPowerOfTen(const PeUint* digits, size_t n_digits, PeUint& n)
+{
+    if ( n_digits == 0 ) {
+        return false;
     }
 
-    if ( n > 0 ) { // Left shift - insert elements at front
-        digits_.insert(digits_.begin(), n, 0);
+    for ( size_t i = 0; i + 1 < n_digits; ++i ) {
+        if ( digits[i] != 0 ) {
+            return false;
+        }
+    }
 
-        // Clear any leading zeros
-        while ( digits_.size() > 1 && digits_.back() == 0 ) {
-            digits_.pop_back();
+    for ( PeUint d = 0; d < limbs::kBasePower; ++d ) {
+        if ( digits[n_digits - 1] == kLimbDigitPowers[d] ) {
+            n = (n_digits - 1) * limbs::kBasePower + d;
+            return true;
         }
-    } else if ( n < 0 ) { // Right shift - remove elements at front
-        digits_.erase(digits_.begin(), digits_.begin() - n);
     }
 
-    return *this;
+    return false;
 }
 
-// Reverse this number's digits
-PeBigInt& PeBigInt::reverseDigits()
+// Window width for sliding window exponentiation with an exponent of
+// <bits> bits, balancing the 2^(k-1) table entries against the roughly
+// bits / (k + 1) multiplications they leave
+PeUint PowerWindowBits(PeUint bits)
 {
-    // First, reverse the digits array
-    reverse(digits_.begin(), digits_.end());
-
-    // Not using accumulate here because we want PeBigInt in case we have overflow
-    for ( auto& i: digits_ ) {
-        i = math::ReverseDigits(i);
+    if ( bits <= 8 ) {
+        return 1;
+    } else if ( bits <= 24 ) {
+        return 3;
+    } else if ( bits <= 80 ) {
+        return 4;
     }
 
-    return *this;
+    return 5;
 }
+} // namespace
 
-// Square this number i.e. n = n * n
-// Used as a helper function for power()
-PeBigInt& PeBigInt::square()
+PeBigInt& PeBigInt::power(PeUint exponent)
 {
-    // Result digits
-    std::vector<PeUint> res(2 * digits_.size(), 0);
+    const int result_sign = (sign_ < 0) && math::IsOdd(exponent) ? -1 : 1;
+
+    if ( exponent == 0 ) {
+        *this = PeBigInt(1);
+        return *this;
+    }
+
+    // (10^n)^exponent = 10^(n * exponent): a single limb power of ten
+    // followed by a radix shift
+    PeUint ten_power = 0;
+    if ( IsPowerOfTen(digits_.data(), digits_.size(), ten_power) ) {
+        const PeUint total = (ten_power + offset_ * kBasePower) * exponent;
 
-    // Outer loop over this numbers digits
-    for ( size_t i = 0; i < digits_.size(); ++i ) {
-        // Inner loop over rhs digits with extra pass if carry occurs
-        for ( size_t j = 0, carry = 0; (j < digits_.size()) || carry; ++j ) {
-            PeInt cur = res[i + j] + digits_[i] * (j < digits_.size() ? digits_[j] : 0) + carry;
+        digits_.assign(1, kLimbDigitPowers[total % kBasePower]);
+        offset_ = 0;
+        radixShift((PeInt)(total / kBasePower));
+        sign_ = result_sign;
 
-            res[i + j] = (int)(cur % kBase);
-            carry      = (size_t)(cur / kBase);
+        return *this;
+    }
+
+    if ( isZero() || (exponent == 1) ) {
+        return *this;
+    }
+
+    // Bits of the exponent
+    PeUint bits = 0;
+    while ( (bits < 64) && ((exponent >> bits) != 0) ) {
+        ++bits;
+    }
+
+    // Odd powers x^1, x^3, ..., x^(2^k - 1) of this number
+    const PeUint          window = PowerWindowBits(bits);
+    std::vector<PeBigInt> odd_powers(size_t(1) << (window - 1), *this);
+
+    if ( odd_powers.size() > 1 ) {
+        PeBigInt base_squared(*this);
+        base_squared.square();
+
+        for ( size_t i = 1; i < odd_powers.size(); ++i ) {
+            odd_powers[i] = odd_powers[i - 1];
+            odd_powers[i] *= base_squared;
         }
     }
 
-    // Clear any leading zeros
-    while ( (res.size() > 1) && (res.back() == 0) ) {
-        res.pop_back();
+    // Scan the exponent from the top bit down. Zero bits square the result;
+    // otherwise the longest window of at most <window> bits ending in a one
+    // is taken, the result squared once per bit and multiplied by the odd
+    // power the window's bits give.
+    PeBigInt result;
+    bool     started = false;
+
+    for ( PeInt top = (PeInt)bits - 1; top >= 0; ) {
+        if ( ((exponent >> top) & 1) == 0 ) {
+            result.square();
+            --top;
+            continue;
+        }
+
+        PeInt bottom = std::max<PeInt>(top - (PeInt)window + 1, 0);
+        while ( ((exponent >> bottom) & 1) == 0 ) {
+            ++bottom;
+        }
+
+        const PeUint width = (PeUint)(top - bottom + 1);
+        const PeUint value = (exponent >> bottom) & ((PeUint(1) << width) - 1);
+
+        if ( started ) {
+            for ( PeUint i = 0; i < width; ++i ) {
+                result.square();
+            }
+            result *= odd_powers[value / 2];
+        } else {
+            result  = odd_powers[value / 2];
+            started = true;
+        }
+
+        top = bottom - 1;
     }
 
-    // Move result to this
-    digits_ = move(res);
+    *this = std::move(result);
+    sign_ = result_sign;
 
     return *this;
 }
 
-// Return the sum of this number's digits (ignores sign)
-PeBigInt PeBigInt::sumDigits()
+// Roots
+
+namespace
+{
+// floor(n^(1/k)) for n > 0 and k >= 2, also storing root^k in <root_power>.
+//
+// Newton's iteration x' = ((k - 1) * x + n / x^(k - 1)) / k never goes
+// below the root from any starting point at or above it, so the first x
+// with x^k <= n is the root. For a starting point, a root of at least two
+// limbs takes the root r of n's leading limbs, n / kBase^(s * k), giving
+// (r + 1) * kBase^s, which has about half the final root's precision, so
+// one or two iterations are enough. Smaller roots start from a long double
+// estimate, worked out via logarithms so that the huge n of a large k
+// doesn't overflow.
+PeBigInt RootFloor(const PeBigInt& n, PeUint k, PeBigInt& root_power)
 {
-    PeBigInt digit_sum(0);
+    const size_t n_limbs    = (n.numDigits() + limbs::kBasePower - 1) / limbs::kBasePower;
+    const size_t root_limbs = n_limbs / k;
 
-    // Not using accumulate here because we want PeBigInt in case we have overflow
-    for ( const auto& i: digits_ ) {
-        digit_sum += PeBigInt(math::SumDigits(i));
-    }
+    PeBigInt x;
+
+    if ( root_limbs >= 2 ) {
+        const size_t shift = root_limbs / 2;
 
-    return digit_sum;
+        PeBigInt leading(n);
+        leading.radixShift(-(PeInt)(shift * k));
+
+        PeBigInt leading_power;
+        x = RootFloor(leading, k, leading_power);
+        x.addSmall(1);
+        x.radixShift((PeInt)shift);
+    } else {
+        // n ~ top * kBase^(n_limbs - 3) using the top three limbs
+        const size_t dropped = n_limbs > 3 ? n_limbs - 3 : 0;
+
+        PeBigInt top(n);
+        top.radixShift(-(PeInt)dropped);
+
+        const long double log10_n  = log10l((long double)top) + (long double)(dropped * limbs::kBasePower);
+        const long double estimate = powl(10.0L, log10_n / k) * (1.0L + 1e-9L) + 1.0L;
+
+        x = PeBigInt(floorl(estimate));
+    }
+
+    // Newton iteration from above
+    for ( ;; ) {
+        PeBigInt x_power(x);
+        x_power.power(k - 1);
+
+        root_power = x_power;
+        root_power *= x;
+        if ( root_power <= n ) {
+            return x;
+        }
+
+        PeBigInt next = n / x_power;
+        next.fma(x, (PeInt)(k - 1));
+        next.divSmall((PeInt)k);
+
+        x = std::move(next);
+    }
+}
+} // namespace
+
+PeBigInt PeBigInt::isqrt() const
+{
+    return iroot(2);
+}
+
+PeBigInt PeBigInt::isqrt(PeBigInt& remainder) const
+{
+    return iroot(2, remainder);
+}
+
+PeBigInt PeBigInt::iroot(PeUint k) const
+{
+    PeBigInt remainder;
+    return iroot(k, remainder);
+}
+
+// Throws runtime_error for k = 0 or an even root of a negative number.
+PeBigInt PeBigInt::iroot(PeUint k, PeBigInt& remainder) const
+{
+    if ( k == 0 ) {
+        throw std::runtime_error("PeBigInt: Zeroth root.");
+    }
+    if ( (sign_ < 0) && !isZero() && math::IsEven(k) ) {
+        throw std::runtime_error("PeBigInt: Even root of a negative number.");
+    }
+
+    if ( (k == 1) || isZero() ) {
+        remainder = PeBigInt(0);
+        return *this;
+    }
+
+    PeBigInt magnitude(*this);
+    magnitude.sign_ = 1;
+
+    PeBigInt root_power;
+    PeBigInt root = RootFloor(magnitude, k, root_power);
+
+    // The remainder takes this number's sign, like the root
+    remainder = magnitude;
+    remainder -= root_power;
+    remainder.sign_ = sign_;
+    root.sign_      = sign_;
+    remainder.normalise();
+
+    return root;
+}
+
+bool PeBigInt::isPerfectPower() const
+{
+    PeBigInt base;
+    PeUint   exponent;
+
+    return isPerfectPower(base, exponent);
+}
+
+// Prime roots are taken for as long as they're exact, so that what's left
+// is the base with the largest exponent. A number with b bits can only be
+// a p-th power for p <= b, and negative numbers only odd powers.
+bool PeBigInt::isPerfectPower(PeBigInt& base, PeUint& exponent) const
+{
+    base     = *this;
+    exponent = 1;
+
+    // 0, 1 and -1 are powers of themselves, so pick the smallest exponent
+    // (odd for -1)
+    if ( isZero() || ((digits_.size() == 1) && (digits_[0] == 1) && (offset_ == 0)) ) {
+        exponent = sign_ < 0 ? 3 : 2;
+        return true;
+    }
+
+    const PeUint        max_bits = (PeUint)(numDigits() * 3.33 + 1.0); // log2(10) < 3.33
+    std::vector<PeUint> primes   = math::GeneratePrimesEratosthenes(max_bits);
+
+    for ( PeUint p: primes ) {
+        if ( (sign_ < 0) && (p == 2) ) {
+            continue;
+        }
+
+        for ( ;; ) {
+            // Bits in the current base
+            if ( p > (PeUint)(base.numDigits() * 3.33 + 1.0) ) {
+                break;
+            }
+
+            PeBigInt remainder;
+            PeBigInt root = base.iroot(p, remainder);
+            if ( !remainder.isZero() ) {
+                break;
+            }
+
+            base = std::move(root);
+            exponent *= p;
+        }
+    }
+
+    return exponent > 1;
+}
+
+// Radix shift function, equivalent to multiplying/dividing by kBase^n
+// Analogous to << and >> operators in binary
+// Positive n gives left shift (std::multiplies), negative n gives right shift (divides)
+PeBigInt& PeBigInt::radixShift(PeInt n)
+{
+    if ( (n == 0) || isZero() ) {
+        return *this;
+    }
+
+    if ( n > 0 ) { // Left shift - more implicit zero limbs
+        offset_ += (size_t)n;
+        return *this;
+    }
+
+    // Right shift - implicit zero limbs go first, then stored limbs are
+    // removed from the front
+    const size_t shift = (size_t)-n;
+    if ( shift <= offset_ ) {
+        offset_ -= shift;
+        return *this;
+    }
+
+    const size_t erase = shift - offset_;
+    offset_            = 0;
+
+    // Right shift of more than digit size sets number to zero
+    if ( erase >= digits_.size() ) {
+        digits_.assign(1, 0);
+    } else {
+        digits_.erase(digits_.begin(), digits_.begin() + erase);
+    }
+    normalise();
+
+    return *this;
+}
+
+// Reverse this number's digits
+PeBigInt& PeBigInt::reverseDigits()
+{
+    if ( isZero() ) {
+        return *this;
+    }
+    reduceOffset(0);
+
+    // Reversing whole limbs reverses the number padded with zeros to a
+    // whole number of limbs, so the top limb's padding ends up as trailing
+    // zeros, to be divided out afterwards
+    PeUint padding = 1;
+    while ( digits_.back() * padding * 10 < kBase ) {
+        padding *= 10;
+    }
+
+    // First, reverse the digits array
+    std::reverse(digits_.begin(), digits_.end());
+
+    // Then each limb's digits, zero padded to a full limb
+    for ( auto& limb: digits_ ) {
+        PeUint reversed = 0;
+        for ( size_t i = 0; i < kBasePower; ++i ) {
+            reversed = 10 * reversed + limb % 10;
+            limb /= 10;
+        }
+        limb = reversed;
+    }
+
+    if ( padding > 1 ) {
+        absShortDivEq(padding);
+    }
+
+    // Trailing zeros of the original number are now leading zeros
+    normalise();
+
+    return *this;
+}
+
+// Square this number i.e. n = n * n
+// Used as a helper function for power()
+PeBigInt& PeBigInt::square()
+{
+    // Result digits
+    LimbVector res(2 * digits_.size(), 0);
+
+    // Size dispatched squaring, computing each cross product once
+    limbs::Square(digits_.data(), digits_.size(), res.data());
+
+    // Clear any leading zeros
+    while ( (res.size() > 1) && (res.back() == 0) ) {
+        res.pop_back();
+    }
+
+    // Move result to this, which is never negative
+    digits_ = std::move(res);
+    offset_ *= 2;
+    sign_   = 1;
+
+    return *this;
+}
+
+// Return the sum of this number's digits (ignores sign)
+PeBigInt PeBigInt::sumDigits()
+{
+    return PeBigInt(digitSum());
+}
+
+namespace
+{
+// Digit sums of every number below 10^4
+const std::array<unsigned char, 10000>& DigitSumTable()
+{
+    static const std::array<unsigned char, 10000> table = [] {
+        std::array<unsigned char, 10000> sums;
+        for ( size_t i = 0; i < sums.size(); ++i ) {
+            sums[i] = (unsigned char)(i % 10 + (i < 10 ? 0 : sums[i / 10]));
+        }
+        return sums;
+    }();
+
+    return table;
+}
+} // namespace
+
+// Each limb is two table lookups. Every digit is at most 9, so the sum
+// can't overflow a PeUint for any number that fits in memory.
+PeUint PeBigInt::digitSum() const
+{
+    const std::array<unsigned char, 10000>& table = DigitSumTable();
+    PeUint                                  total = 0;
+
+    for ( PeUint limb: digits_ ) {
+        total += table[limb % 10000] + table[limb / 10000];
+    }
+
+    return total;
+}
+
+// Full limbs below the most significant one (including the offset's),
+// plus that one's digits
+size_t PeBigInt::numDigits() const
+{
+    if ( digits_.empty() ) {
+        return 1;
+    }
+
+    size_t top_digits = 1;
+    while ( (top_digits < kBasePower) && (digits_.back() >= kLimbDigitPowers[top_digits]) ) {
+        ++top_digits;
+    }
+
+    return (digits_.size() + offset_ - 1) * kBasePower + top_digits;
+}
+
+PeBigIntDigits PeBigInt::digits() const
+{
+    // Zero may have no limbs at all, so give it one to read
+    static const PeUint zero_limb = 0;
+
+    if ( digits_.empty() ) {
+        return PeBigIntDigits(&zero_limb, 1);
+    }
+
+    return PeBigIntDigits(digits_.data(), numDigits(), offset_ * kBasePower);
+}
+
+std::array<PeUint, 10> PeBigInt::digitHistogram() const
+{
+    std::array<PeUint, 10> counts = {};
+
+    if ( digits_.empty() ) {
+        counts[0] = 1;
+        return counts;
+    }
+
+    // Full limbs have all kBasePower digits, including leading zeros
+    counts[0] = offset_ * kBasePower;
+    for ( size_t i = 0; i + 1 < digits_.size(); ++i ) {
+        PeUint limb = digits_[i];
+        for ( PeUint d = 0; d < kBasePower; ++d ) {
+            ++counts[limb % 10];
+            limb /= 10;
+        }
+    }
+
+    // The most significant limb stops at its leading digit
+    PeUint top = digits_.back();
+    do {
+        ++counts[top % 10];
+        top /= 10;
+    } while ( top > 0 );
+
+    return counts;
+}
+
+// Product trees
+
+// Factor ranges up to this length are multiplied in one at a time
+const PeUint kProductLeafSize = 16;
+
+namespace
+{
+// Multiply <factor> into a product held as product * packed. Small factors
+// are collected in <packed> until it would overflow, so the leaves of a
+// product tree do one limb multiplication per few factors.
+void MultiplyPacked(PeBigInt& product, PeUint& packed, PeUint factor)
+{
+    if ( (factor != 0) && (packed > std::numeric_limits<PeUint>::max() / factor) ) {
+        product *= PeBigInt(packed);
+        packed = 1;
+    }
+
+    packed *= factor;
+}
+
+void MultiplyPacked(PeBigInt& product, PeUint& /*packed*/, const PeBigInt& factor)
+{
+    product *= factor;
+}
+
+// Product of factor(i) for i in [first, last), splitting the range in half
+// until it's short enough to multiply out directly
+template <typename Factor>
+PeBigInt ProductTree(const Factor& factor, PeUint first, PeUint last)
+{
+    if ( last - first <= kProductLeafSize ) {
+        PeBigInt product(1);
+        PeUint   packed = 1;
+
+        for ( PeUint i = first; i < last; ++i ) {
+            MultiplyPacked(product, packed, factor(i));
+        }
+        product *= PeBigInt(packed);
+
+        return product;
+    }
+
+    const PeUint mid = first + (last - first) / 2;
+
+    PeBigInt product = ProductTree(factor, first, mid);
+    product *= ProductTree(factor, mid, last);
+
+    return product;
+}
+} // namespace
+
+PeBigInt PeBigInt::Factorial(PeUint n)
+{
+    const std::vector<PeUint> primes = math::GeneratePrimesEratosthenes(n);
+
+    // Exponent of each prime in n!, by Legendre's formula
+    std::vector<PeUint> exponents(primes.size());
+    PeUint              max_exponent = 0;
+
+    for ( size_t i = 0; i < primes.size(); ++i ) {
+        for ( PeUint m = n / primes[i]; m > 0; m /= primes[i] ) {
+            exponents[i] += m;
+        }
+        max_exponent = std::max(max_exponent, exponents[i]);
+    }
+
+    // n! = product over bits k of (product of primes with bit k set in
+    // their exponent)^(2^k), evaluated from the top bit down by squaring
+    PeUint top_bit = 1;
+    while ( top_bit <= max_exponent / 2 ) {
+        top_bit *= 2;
+    }
+
+    PeBigInt            result(1);
+    std::vector<PeUint> selected;
+
+    for ( PeUint bit = top_bit; (bit > 0) && (max_exponent > 0); bit /= 2 ) {
+        result.square();
+
+        selected.clear();
+        for ( size_t i = 0; i < primes.size(); ++i ) {
+            if ( exponents[i] & bit ) {
+                selected.push_back(primes[i]);
+            }
+        }
+
+        result *= ProductOf(selected);
+    }
+
+    return result;
+}
+
+PeBigInt PeBigInt::PrimorialUpTo(PeUint n)
+{
+    return ProductOf(math::GeneratePrimesEratosthenes(n));
+}
+
+PeBigInt PeBigInt::ProductOf(PeUint first, PeUint last)
+{
+    if ( last < first ) {
+        return PeBigInt(1);
+    }
+
+    // The tree covers [first, last) and the last factor is multiplied in
+    // after, as last + 1 would overflow when last is the largest PeUint
+    PeBigInt product = ProductTree([](PeUint i) { return i; }, first, last);
+    product *= PeBigInt(last);
+
+    return product;
+}
+
+PeBigInt PeBigInt::ProductOf(const std::vector<PeUint>& factors)
+{
+    return ProductTree([&](PeUint i) { return factors[i]; }, 0, factors.size());
+}
+
+PeBigInt PeBigInt::ProductOf(const std::vector<PeBigInt>& factors)
+{
+    return ProductTree([&](PeUint i) -> const PeBigInt& { return factors[i]; }, 0, factors.size());
+}
+
+// Greatest common divisors
+
+namespace
+{
+// Stein's binary GCD: strip the common factors of two, then repeatedly
+// subtract the smaller odd number from the larger and strip the new factors
+// of two, which costs shifts and subtractions rather than divisions
+PeUint BinaryGcd(PeUint a, PeUint b)
+{
+    if ( a == 0 ) {
+        return b;
+    }
+    if ( b == 0 ) {
+        return a;
+    }
+
+    const int shift = intrinsics::CountTrailingZeros(a | b);
+    a >>= intrinsics::CountTrailingZeros(a);
+
+    do {
+        b >>= intrinsics::CountTrailingZeros(b);
+        if ( a > b ) {
+            std::swap(a, b);
+        }
+        b -= a;
+    } while ( b != 0 );
+
+    return a << shift;
+}
+
+// floor(x / (kBase^(n - 3) * 10^shift)) for x of nx <= n limbs, where
+// n >= 3 and shift < kBasePower - 1
+PeUint LeadingDigits(const PeUint* x, size_t nx, size_t n, size_t shift)
+{
+    const PeUint top    = nx >= n ? x[n - 1] : 0;
+    const PeUint middle = nx >= n - 1 ? x[n - 2] : 0;
+    const PeUint bottom = nx >= n - 2 ? x[n - 3] : 0;
+
+    // 10^(kBasePower - shift)
+    const PeUint scale = shift == 0 ? limbs::kBase : kLimbDigitPowers[limbs::kBasePower - shift];
+
+    return (top * limbs::kBase + middle) * scale + bottom / kLimbDigitPowers[shift];
+}
+
+// result = x * j + y * k, for |j|, |k| < kBase
+void LinearCombination(PeBigInt& result, const PeBigInt& x, PeInt j, const PeBigInt& y, PeInt k)
+{
+    result = x;
+    result.mulSmall(j);
+    result.fma(y, k);
+}
+} // namespace
+
+// Knuth, TAOCP volume 2, section 4.5.2, algorithm L. The leading digits of
+// a, and those of b at the same position, give bounds on each quotient
+// of Euclid's algorithm. While both bounds agree the quotient is known, so
+// Euclid's algorithm carries on with the leading limbs alone, recording the
+// steps as a matrix [A B; C D]. The cofactors are kept below kBase so the
+// matrix can be applied with single limb multiplications, which also means
+// each step removes about a limb from the numbers. When the first quotient
+// is already uncertain, e.g. because b is much shorter than a, a full
+// division step is made instead.
+void PeBigInt::lehmerGcd(PeBigInt& a, PeBigInt& b, PeBigInt* u, PeBigInt* v)
+{
+    PeBigInt next_a;
+    PeBigInt next_b;
+    PeBigInt next_u;
+    PeBigInt next_v;
+
+    while ( !b.isZero() ) {
+        const size_t n = a.digits_.size();
+
+        // Once the cofactors aren't needed, finish in machine words
+        if ( !u && (n <= 2) ) {
+            a = PeBigInt(BinaryGcd((PeUint)a, (PeUint)b));
+            b = PeBigInt(0);
+            return;
+        }
+        if ( !u && (b.digits_.size() == 1) ) {
+            const PeUint divisor = b.digits_[0];
+            a = PeBigInt(BinaryGcd(divisor, a.absShortDivEq(divisor)));
+            b = PeBigInt(0);
+            return;
+        }
+
+        // Leading digits of a, and of b at the same scale. Numbers of up to
+        // two limbs are used exactly, and longer ones are cut down to
+        // between 17 and 18 digits from their top three limbs.
+        PeInt a_hat = (PeInt)(PeUint)a;
+        PeInt b_hat = (PeInt)(PeUint)b;
+        if ( n > 2 ) {
+            size_t top_digits = 1;
+            while ( (top_digits < kBasePower) && (a.digits_[n - 1] >= kLimbDigitPowers[top_digits]) ) {
+                ++top_digits;
+            }
+            const size_t shift = top_digits > 2 ? top_digits - 2 : 0;
+
+            a_hat = (PeInt)LeadingDigits(a.digits_.data(), n, n, shift);
+            b_hat = (PeInt)LeadingDigits(b.digits_.data(), b.digits_.size(), n, shift);
+        }
+
+        PeInt m_a = 1;
+        PeInt m_b = 0;
+        PeInt m_c = 0;
+        PeInt m_d = 1;
+
+        for ( ;; ) {
+            if ( (b_hat + m_c <= 0) || (b_hat + m_d <= 0) ) {
+                break;
+            }
+
+            const PeInt q = (a_hat + m_a) / (b_hat + m_c);
+            if ( q != (a_hat + m_b) / (b_hat + m_d) ) {
+                break;
+            }
+
+            const PeInt c = m_a - q * m_c;
+            const PeInt d = m_b - q * m_d;
+            if ( (c <= -(PeInt)kBase) || (c >= (PeInt)kBase) || (d <= -(PeInt)kBase) || (d >= (PeInt)kBase) ) {
+                break;
+            }
+
+            const PeInt r = a_hat - q * b_hat;
+
+            m_a   = m_c;
+            m_b   = m_d;
+            m_c   = c;
+            m_d   = d;
+            a_hat = b_hat;
+            b_hat = r;
+        }
+
+        if ( m_b == 0 ) {
+            // a, b = b, a mod b
+            PeBigInt remainder;
+            a.divmod(b, remainder);
+            if ( u ) {
+                next_u = *u - a * *v;
+                std::swap(*u, *v);
+                std::swap(*v, next_u);
+            }
+            std::swap(a, b);
+            std::swap(b, remainder);
+        } else {
+            LinearCombination(next_a, a, m_a, b, m_b);
+            LinearCombination(next_b, a, m_c, b, m_d);
+            std::swap(a, next_a);
+            std::swap(b, next_b);
+
+            if ( u ) {
+                LinearCombination(next_u, *u, m_a, *v, m_b);
+                LinearCombination(next_v, *u, m_c, *v, m_d);
+                std::swap(*u, next_u);
+                std::swap(*v, next_v);
+            }
+        }
+    }
+}
+
+PeBigInt PeBigInt::Gcd(const PeBigInt& a, const PeBigInt& b)
+{
+    const bool a_larger = !a.absLt(b);
+
+    PeBigInt larger  = a_larger ? a : b;
+    PeBigInt smaller = a_larger ? b : a;
+    larger.sign_     = 1;
+    smaller.sign_    = 1;
+    larger.reduceOffset(0);
+    smaller.reduceOffset(0);
+
+    lehmerGcd(larger, smaller, nullptr, nullptr);
+
+    return larger;
+}
+
+// lcm(a, b) = (a / gcd(a, b)) * b, dividing the smaller number so the
+// division has the shortest quotient
+PeBigInt PeBigInt::Lcm(const PeBigInt& a, const PeBigInt& b)
+{
+    if ( a.isZero() || b.isZero() ) {
+        return PeBigInt(0);
+    }
+
+    const bool a_larger = !a.absLt(b);
+
+    PeBigInt lcm  = a_larger ? b : a;
+    lcm.sign_     = 1;
+    lcm /= Gcd(a, b);
+    lcm *= a_larger ? a : b;
+    lcm.sign_     = 1;
+
+    return lcm;
+}
+
+// Only the cofactor of the larger number is tracked; the other follows
+// from an exact division at the end
+PeBigInt PeBigInt::ExtendedGcd(const PeBigInt& a, const PeBigInt& b, PeBigInt& x, PeBigInt& y)
+{
+    const bool a_larger = !a.absLt(b);
+
+    const PeBigInt& larger  = a_larger ? a : b;
+    const PeBigInt& smaller = a_larger ? b : a;
+
+    PeBigInt abs_larger(larger);
+    PeBigInt abs_smaller(smaller);
+    abs_larger.sign_  = 1;
+    abs_smaller.sign_ = 1;
+    abs_larger.reduceOffset(0);
+    abs_smaller.reduceOffset(0);
+
+    // Start from |larger| = 1 * |larger| and |smaller| = 0 * |larger|,
+    // modulo |smaller|
+    PeBigInt g(abs_larger);
+    PeBigInt r(abs_smaller);
+    PeBigInt larger_x(1);
+    PeBigInt r_x(0);
+    lehmerGcd(g, r, &larger_x, &r_x);
+
+    // Solve g = larger_x * |larger| + smaller_x * |smaller| for smaller_x
+    PeBigInt smaller_x(0);
+    if ( !smaller.isZero() ) {
+        smaller_x = g - larger_x * abs_larger;
+        smaller_x /= abs_smaller;
+    }
+
+    // Fold the signs of a and b into their cofactors
+    larger_x.mulSmall(larger.sign_);
+    smaller_x.mulSmall(smaller.sign_);
+
+    x = std::move(a_larger ? larger_x : smaller_x);
+    y = std::move(a_larger ? smaller_x : larger_x);
+
+    return g;
+}
+
+// Throws runtime_error if m isn't positive or a and m aren't coprime.
+PeBigInt PeBigInt::ModInverse(const PeBigInt& a, const PeBigInt& m)
+{
+    if ( (m.sign_ < 0) || m.isZero() ) {
+        throw std::runtime_error("PeBigInt: Modulus must be positive.");
+    }
+
+    PeBigInt r = a % m;
+    if ( r.sign_ < 0 ) {
+        r += m;
+    }
+
+    // Start from m = 0 * r and r = 1 * r, modulo m, so the GCD ends up as
+    // inverse * r
+    PeBigInt g(m);
+    PeBigInt inverse(0);
+    PeBigInt r_x(1);
+    g.reduceOffset(0);
+    r.reduceOffset(0);
+    lehmerGcd(g, r, &inverse, &r_x);
+
+    if ( g != PeBigInt(1) ) {
+        throw std::runtime_error("PeBigInt: No modular inverse.");
+    }
+
+    if ( inverse.sign_ < 0 ) {
+        inverse += m;
+    }
+
+    return inverse;
+}
+
+// Expression evaluation, see PeBigIntExpr.h
+
+// Temporary operands must be owned by the expression, so that e.g.
+// auto r = f() + g() * h(); doesn't refer to destroyed values
+static_assert(std::is_same<decltype(std::declval<PeBigInt>() + std::declval<PeBigInt>() * std::declval<PeBigInt>()),
+                           PeBigIntSum<PeBigIntValue, PeBigIntProduct<PeBigIntValue, PeBigIntValue>>>::value,
+              "PeBigInt expressions must own their temporary operands");
+static_assert(std::is_same<decltype(std::declval<const PeBigInt&>() - std::declval<PeBigInt>()),
+                           PeBigIntSum<PeBigIntRef, PeBigIntValue>>::value,
+              "PeBigInt expressions must own their temporary operands");
+
+PeBigIntAccumulator::PeBigIntAccumulator() : offset_(0) {}
+
+void PeBigIntAccumulator::add(const PeBigInt& value, int sign)
+{
+    if ( !value.isZero() ) {
+        addLimbs(value.digits_.data(), value.digits_.size(), value.offset_, sign * value.sign_ < 0);
+    }
+}
+
+void PeBigIntAccumulator::addProduct(const PeBigInt& lhs, const PeBigInt& rhs, int sign)
+{
+    if ( lhs.isZero() || rhs.isZero() ) {
+        return;
+    }
+
+    // Product into scratch limbs
+    const size_t         n_lhs = lhs.digits_.size();
+    const size_t         n_rhs = rhs.digits_.size();
+    PeBigInt::LimbVector product(n_lhs + n_rhs);
+    limbs::Multiply(lhs.digits_.data(), n_lhs, rhs.digits_.data(), n_rhs, product.data());
+
+    addLimbs(product.data(), product.size(), lhs.offset_ + rhs.offset_, sign * lhs.sign_ * rhs.sign_ < 0);
+}
+
+// Add into the positive or negative sum. The limb addition kernels resolve
+// carries a whole vector of limbs at a time, so there's nothing left to
+// propagate afterwards.
+void PeBigIntAccumulator::addLimbs(const PeUint* limbs, size_t n, size_t offset, bool negative)
+{
+    // Lower the sums' offset to this term's, if it's the lowest yet
+    if ( positive_.empty() && negative_.empty() ) {
+        offset_ = offset;
+    } else if ( offset < offset_ ) {
+        if ( !positive_.empty() ) {
+            positive_.insert(positive_.begin(), offset_ - offset, 0);
+        }
+        if ( !negative_.empty() ) {
+            negative_.insert(negative_.begin(), offset_ - offset, 0);
+        }
+        offset_ = offset;
+    }
+
+    PeBigInt::LimbVector& sum      = negative ? negative_ : positive_;
+    const size_t          position = offset - offset_;
+    const size_t          length   = std::max(sum.size(), position + n) + 1;
+
+    sum.resize(length, 0);
+    limbs::AddTo(sum.data() + position, length - position, limbs, n);
+
+    // Drop the carry limb if it wasn't needed
+    if ( sum.back() == 0 ) {
+        sum.pop_back();
+    }
+}
+
+void PeBigIntAccumulator::finish(PeBigInt& result)
+{
+    // Subtract the smaller magnitude from the larger
+    int cmp = limbs::Compare(positive_.data(), positive_.size(), negative_.data(), negative_.size());
+
+    PeBigInt::LimbVector& larger  = cmp >= 0 ? positive_ : negative_;
+    PeBigInt::LimbVector& smaller = cmp >= 0 ? negative_ : positive_;
+
+    // Compare() ignores leading zeros, so trim the smaller before subtracting
+    while ( !smaller.empty() && (smaller.back() == 0) ) {
+        smaller.pop_back();
+    }
+    limbs::SubtractFrom(larger.data(), larger.size(), smaller.data(), smaller.size());
+
+    while ( !larger.empty() && (larger.back() == 0) ) {
+        larger.pop_back();
+    }
+
+    // Zero is kept positive
+    if ( larger.empty() ) {
+        result.digits_.assign(1, 0);
+        result.sign_   = 1;
+        result.offset_ = 0;
+    } else {
+        result.digits_ = std::move(larger);
+        result.sign_   = cmp > 0 ? 1 : -1;
+        result.offset_ = offset_;
+    }
 }
 
 } // namespace pe
\ No newline at end of file
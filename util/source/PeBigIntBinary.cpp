@@ -0,0 +1,1074 @@
+// Copyright 2020-2023 Paul Robertson
+//
+// PeBigIntBinary.cpp
+//
+// A binary limb variant of the arbitrary precision signed integer class
+
+#include "PeBigIntBinary.h"
+#include "PeLimbArithmetic.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+
+namespace pe
+{
+// Crossover (in limbs) between schoolbook and Karatsuba multiplication
+// for binary limbs
+const size_t kBinaryKaratsubaThreshold = 32;
+
+// Binary limb arithmetic helpers.
+// These mirror the base 10^8 helpers in PeLimbArithmetic, working on
+// little endian arrays of 64 bit limbs.
+
+namespace
+{
+// r += a for na <= nr, returning the carry out of r
+PeUint BinaryAddTo(PeUint* r, size_t nr, const PeUint* a, size_t na)
+{
+    PeUint carry = 0;
+    size_t i     = 0;
+
+    for ( ; i < na; ++i ) {
+        r[i] = intrinsics::AddCarry(r[i], a[i], carry);
+    }
+
+    for ( ; carry && (i < nr); ++i ) {
+        carry = ++r[i] == 0;
+    }
+
+    return carry;
+}
+
+// r -= a for na <= nr, returning the borrow out of r
+PeUint BinarySubtractFrom(PeUint* r, size_t nr, const PeUint* a, size_t na)
+{
+    PeUint borrow = 0;
+    size_t i      = 0;
+
+    for ( ; i < na; ++i ) {
+        r[i] = intrinsics::SubBorrow(r[i], a[i], borrow);
+    }
+
+    for ( ; borrow && (i < nr); ++i ) {
+        borrow = r[i]-- == 0;
+    }
+
+    return borrow;
+}
+
+// Length of a limb array ignoring leading zero limbs
+size_t BinaryTrimmedLength(const PeUint* a, size_t na)
+{
+    while ( (na > 0) && (a[na - 1] == 0) ) {
+        --na;
+    }
+
+    return na;
+}
+
+void BinaryMultiply(const PeUint* a, size_t na, const PeUint* b, size_t nb, PeUint* res);
+
+// Schoolbook multiplication writing na + nb limbs to res.
+// Each 128 bit partial product is split into its low word, which is added
+// in place, and its high word, which becomes the next carry.
+void BinaryMultiplySchoolbook(const PeUint* a, size_t na, const PeUint* b, size_t nb, PeUint* res)
+{
+    std::fill(res, res + na + nb, 0);
+
+    for ( size_t i = 0; i < na; ++i ) {
+        PeUint carry = 0;
+
+        for ( size_t j = 0; j < nb; ++j ) {
+            PeUint hi;
+            PeUint lo = intrinsics::MulWide(a[i], b[j], hi);
+
+            lo += res[i + j];
+            hi += lo < res[i + j];
+            lo += carry;
+            hi += lo < carry;
+
+            res[i + j] = lo;
+            carry      = hi;
+        }
+
+        res[i + nb] = carry;
+    }
+}
+
+// Karatsuba multiplication for nb <= na < 2 * nb, as in PeLimbArithmetic
+void BinaryMultiplyKaratsuba(const PeUint* a, size_t na, const PeUint* b, size_t nb, PeUint* res)
+{
+    const size_t k  = na / 2;
+    const size_t a1 = na - k;
+    const size_t b1 = nb - k;
+
+    // z0 and z2 go straight into the low and high parts of the result
+    BinaryMultiply(a, k, b, k, res);
+    BinaryMultiply(a + k, a1, b + k, b1, res + 2 * k);
+
+    // Sums of the halves
+    std::vector<PeUint> sum_a(a1 + 1, 0), sum_b(std::max(k, b1) + 1, 0);
+
+    std::copy(a + k, a + na, sum_a.begin());
+    sum_a[a1] = BinaryAddTo(sum_a.data(), a1, a, k);
+
+    if ( b1 >= k ) {
+        std::copy(b + k, b + nb, sum_b.begin());
+        sum_b[b1] = BinaryAddTo(sum_b.data(), b1, b, k);
+    } else {
+        std::copy(b, b + k, sum_b.begin());
+        sum_b[k] = BinaryAddTo(sum_b.data(), k, b + k, b1);
+    }
+
+    const size_t        n_sum_a = BinaryTrimmedLength(sum_a.data(), sum_a.size());
+    const size_t        n_sum_b = BinaryTrimmedLength(sum_b.data(), sum_b.size());
+    std::vector<PeUint> z1(n_sum_a + n_sum_b);
+    BinaryMultiply(sum_a.data(), n_sum_a, sum_b.data(), n_sum_b, z1.data());
+
+    // z1 - z0 - z2 is the (non-negative) middle term
+    BinarySubtractFrom(z1.data(), z1.size(), res, BinaryTrimmedLength(res, 2 * k));
+    BinarySubtractFrom(z1.data(), z1.size(), res + 2 * k, BinaryTrimmedLength(res + 2 * k, a1 + b1));
+
+    BinaryAddTo(res + k, na + nb - k, z1.data(), BinaryTrimmedLength(z1.data(), z1.size()));
+}
+
+// Size dispatched multiplication writing na + nb limbs to res,
+// which must not overlap the inputs
+void BinaryMultiply(const PeUint* a, size_t na, const PeUint* b, size_t nb, PeUint* res)
+{
+    if ( na < nb ) {
+        std::swap(a, b);
+        std::swap(na, nb);
+    }
+
+    if ( nb < kBinaryKaratsubaThreshold ) {
+        BinaryMultiplySchoolbook(a, na, b, nb, res);
+        return;
+    }
+
+    // Unbalanced operands: accumulate balanced products of nb limb chunks
+    if ( na >= 2 * nb ) {
+        std::vector<PeUint> prod(2 * nb);
+        std::fill(res, res + na + nb, 0);
+
+        for ( size_t offset = 0; offset < na; offset += nb ) {
+            size_t chunk = std::min(nb, na - offset);
+            BinaryMultiply(a + offset, chunk, b, nb, prod.data());
+            BinaryAddTo(res + offset, na + nb - offset, prod.data(), chunk + nb);
+        }
+
+        return;
+    }
+
+    BinaryMultiplyKaratsuba(a, na, b, nb, res);
+}
+
+// Knuth's Algorithm D in base 2^64 (see PeLimbArithmetic for base 10^8).
+// Normalisation is a left shift so that the top divisor bit is set.
+// Writes nu - nv + 1 quotient limbs to q and nv remainder limbs to r.
+void BinaryDivide(const PeUint* u, size_t nu, const PeUint* v, size_t nv, PeUint* q, PeUint* r)
+{
+    // Single limb divisor: short division
+    if ( nv == 1 ) {
+        PeUint rem = 0;
+        for ( size_t i = nu; i-- > 0; ) {
+            q[i] = intrinsics::DivWide(rem, u[i], v[0], rem);
+        }
+        r[0] = rem;
+        return;
+    }
+
+    // Normalise
+    const int           s = intrinsics::CountLeadingZeros(v[nv - 1]);
+    std::vector<PeUint> un(nu + 1), vn(nv);
+
+    for ( size_t i = nv; i-- > 0; ) {
+        vn[i] = (v[i] << s) | ((s && i > 0) ? (v[i - 1] >> (64 - s)) : 0);
+    }
+
+    un[nu] = s ? (u[nu - 1] >> (64 - s)) : 0;
+    for ( size_t i = nu; i-- > 0; ) {
+        un[i] = (u[i] << s) | ((s && i > 0) ? (u[i - 1] >> (64 - s)) : 0);
+    }
+
+    const PeUint v_top  = vn[nv - 1];
+    const PeUint v_next = vn[nv - 2];
+
+    for ( size_t j = nu - nv + 1; j-- > 0; ) {
+        // Estimate the quotient limb from the leading limbs.
+        // The top limb can equal v_top (never exceed it), in which case the
+        // estimate is B - 1 and the remainder estimate may overflow.
+        PeUint q_hat, r_hat;
+        bool   r_hat_overflow = false;
+
+        if ( un[j + nv] >= v_top ) {
+            q_hat          = ~0ull;
+            r_hat          = un[j + nv - 1] + v_top;
+            r_hat_overflow = r_hat < v_top;
+        } else {
+            q_hat = intrinsics::DivWide(un[j + nv], un[j + nv - 1], v_top, r_hat);
+        }
+
+        while ( !r_hat_overflow ) {
+            PeUint p_hi;
+            PeUint p_lo = intrinsics::MulWide(q_hat, v_next, p_hi);
+
+            if ( (p_hi < r_hat) || ((p_hi == r_hat) && (p_lo <= un[j + nv - 2])) ) {
+                break;
+            }
+
+            --q_hat;
+            r_hat += v_top;
+            r_hat_overflow = r_hat < v_top;
+        }
+
+        // Multiply and subtract
+        PeUint borrow = 0, carry = 0;
+        for ( size_t i = 0; i < nv; ++i ) {
+            PeUint p_hi;
+            PeUint p_lo = intrinsics::MulWide(q_hat, vn[i], p_hi);
+
+            p_lo += carry;
+            p_hi += p_lo < carry;
+            carry = p_hi;
+
+            un[i + j] = intrinsics::SubBorrow(un[i + j], p_lo, borrow);
+        }
+        un[j + nv] = intrinsics::SubBorrow(un[j + nv], carry, borrow);
+
+        // Add back if the estimate was one too large
+        if ( borrow ) {
+            --q_hat;
+            BinaryAddTo(&un[j], nv + 1, vn.data(), nv);
+        }
+
+        q[j] = q_hat;
+    }
+
+    // Unnormalise the remainder
+    for ( size_t i = 0; i < nv; ++i ) {
+        r[i] = (un[i] >> s) | (s ? (un[i + 1] << (64 - s)) : 0);
+    }
+}
+} // namespace
+
+PeBigIntBinary::PeBigIntBinary() : sign_(1), limbs_(1, 0) {}
+
+// Copy and move constructors
+PeBigIntBinary::PeBigIntBinary(const PeBigIntBinary& that) : sign_(that.sign_), limbs_(that.limbs_) {}
+
+PeBigIntBinary::PeBigIntBinary(PeBigIntBinary&& that) noexcept : sign_(that.sign_), limbs_(std::move(that.limbs_))
+{
+}
+
+// Constructors from integer types
+PeBigIntBinary::PeBigIntBinary(int val) : sign_(1)
+{
+    fromSigned(val);
+}
+
+PeBigIntBinary::PeBigIntBinary(long int val) : sign_(1)
+{
+    fromSigned(val);
+}
+
+PeBigIntBinary::PeBigIntBinary(PeInt val) : sign_(1)
+{
+    fromSigned(val);
+}
+
+PeBigIntBinary::PeBigIntBinary(unsigned val) : sign_(1)
+{
+    fromUnsigned(val);
+}
+
+PeBigIntBinary::PeBigIntBinary(long unsigned val) : sign_(1)
+{
+    fromUnsigned(val);
+}
+
+PeBigIntBinary::PeBigIntBinary(PeUint val) : sign_(1)
+{
+    fromUnsigned(val);
+}
+
+// Constructors from floating point types
+PeBigIntBinary::PeBigIntBinary(float val) : sign_(1)
+{
+    fromFloating(val);
+}
+
+PeBigIntBinary::PeBigIntBinary(double val) : sign_(1)
+{
+    fromFloating(val);
+}
+
+PeBigIntBinary::PeBigIntBinary(long double val) : sign_(1)
+{
+    fromFloating(val);
+}
+
+// String constructors
+PeBigIntBinary::PeBigIntBinary(const char* valstr) : sign_(1)
+{
+    fromString(valstr);
+}
+
+PeBigIntBinary::PeBigIntBinary(const std::string& valstr) : sign_(1)
+{
+    fromString(valstr);
+}
+
+PeBigIntBinary::~PeBigIntBinary() {}
+
+// Copy and move assignment operator
+PeBigIntBinary& PeBigIntBinary::operator=(const PeBigIntBinary& rhs)
+{
+    // Check for self assignment
+    if ( this == &rhs ) {
+        return *this;
+    }
+
+    sign_  = rhs.sign_;
+    limbs_ = rhs.limbs_;
+
+    return *this;
+}
+
+PeBigIntBinary& PeBigIntBinary::operator=(PeBigIntBinary&& rhs) noexcept
+{
+    // Check for self assignment
+    if ( this == &rhs ) {
+        return *this;
+    }
+
+    sign_  = rhs.sign_;
+    limbs_ = std::move(rhs.limbs_);
+
+    return *this;
+}
+
+// Unary operators
+PeBigIntBinary PeBigIntBinary::operator-() const
+{
+    PeBigIntBinary negative_this(*this);
+
+    // Zero is always kept positive
+    if ( !isZero() ) {
+        negative_this.sign_ = -sign_;
+    }
+
+    return negative_this;
+}
+
+// Relational operators
+bool PeBigIntBinary::operator<(const PeBigIntBinary& rhs) const
+{
+    // Sign checks: zero is always stored as positive so this is safe
+    if ( sign_ != rhs.sign_ ) {
+        return sign_ < rhs.sign_;
+    }
+
+    // Same signs: compare absolute values, inverting for negatives
+    return sign_ < 0 ? rhs.absLt(*this) : absLt(rhs);
+}
+
+bool PeBigIntBinary::operator>(const PeBigIntBinary& rhs) const
+{
+    return rhs < *this;
+}
+
+bool PeBigIntBinary::operator<=(const PeBigIntBinary& rhs) const
+{
+    return !(*this > rhs);
+}
+
+bool PeBigIntBinary::operator>=(const PeBigIntBinary& rhs) const
+{
+    return !(*this < rhs);
+}
+
+bool PeBigIntBinary::operator==(const PeBigIntBinary& rhs) const
+{
+    return (sign_ == rhs.sign_) && absEq(rhs);
+}
+
+bool PeBigIntBinary::operator!=(const PeBigIntBinary& rhs) const
+{
+    return !(*this == rhs);
+}
+
+// Arithmetic operators
+
+PeBigIntBinary& PeBigIntBinary::operator+=(const PeBigIntBinary& rhs)
+{
+    // Use signs to determine which operations are needed
+    if ( sign_ == rhs.sign_ ) {
+        absPlusEq(rhs);
+    } else if ( absLt(rhs) ) {
+        // Larger rhs: subtract this from a copy of rhs and take its sign
+        PeBigIntBinary rhs_copy(rhs);
+        rhs_copy.absMinusEq(*this);
+        *this = std::move(rhs_copy);
+    } else {
+        absMinusEq(rhs);
+    }
+
+    return *this;
+}
+
+PeBigIntBinary& PeBigIntBinary::operator-=(const PeBigIntBinary& rhs)
+{
+    // Turn subtraction into addition
+    operator+=(-rhs);
+
+    return *this;
+}
+
+PeBigIntBinary& PeBigIntBinary::operator*=(const PeBigIntBinary& rhs)
+{
+    int rhs_sign = rhs.sign_;
+
+    // Do multiplication of absolute values then multiply signs
+    absMultEq(rhs);
+    sign_ = isZero() ? 1 : sign_ * rhs_sign;
+
+    return *this;
+}
+
+PeBigIntBinary& PeBigIntBinary::operator/=(const PeBigIntBinary& rhs)
+{
+    int rhs_sign = rhs.sign_;
+
+    // Do division of absolute values then multiply signs
+    absDivModEq(rhs, nullptr);
+    sign_ = isZero() ? 1 : sign_ * rhs_sign;
+
+    return *this;
+}
+
+PeBigIntBinary& PeBigIntBinary::operator%=(const PeBigIntBinary& rhs)
+{
+    // Keep the remainder and discard the quotient
+    PeBigIntBinary remainder;
+    divmod(rhs, remainder);
+    *this = std::move(remainder);
+
+    return *this;
+}
+
+// Conversion operators
+// Values that are too large for the data type
+// will be converted to the maximum value for
+// said data type
+
+// Conversion to integer types
+PeBigIntBinary::operator PeInt() const
+{
+    const PeUint magnitude = limbs_[0];
+
+    if ( sign_ > 0 ) {
+        if ( (limbs_.size() > 1) || (magnitude > (PeUint)INTMAX_MAX) ) {
+            return INTMAX_MAX;
+        }
+        return (PeInt)magnitude;
+    }
+
+    // The magnitude of INTMAX_MIN is one more than INTMAX_MAX
+    if ( (limbs_.size() > 1) || (magnitude > (PeUint)INTMAX_MAX + 1) ) {
+        return INTMAX_MIN;
+    }
+
+    return magnitude == (PeUint)INTMAX_MAX + 1 ? INTMAX_MIN : -(PeInt)magnitude;
+}
+
+PeBigIntBinary::operator PeUint() const
+{
+    // Negative numbers are returned as 0
+    if ( sign_ < 0 ) {
+        return 0ull;
+    }
+
+    return limbs_.size() > 1 ? UINTMAX_MAX : limbs_[0];
+}
+
+// Conversion to floating point
+PeBigIntBinary::operator long double() const
+{
+    // Quick check for size overflow
+    if ( limbs_.size() * 64 > (size_t)LDBL_MAX_EXP ) {
+        return sign_ > 0 ? LDBL_MAX : -LDBL_MAX;
+    }
+
+    // Horner's method from the most significant limb
+    long double sum = 0.0;
+    for ( auto i_limb = limbs_.rbegin(); i_limb != limbs_.rend(); ++i_limb ) {
+        sum = ldexpl(sum, 64) + (long double)*i_limb;
+    }
+
+    // Catch any overflow from the final limb
+    if ( sum > LDBL_MAX ) {
+        sum = LDBL_MAX;
+    }
+
+    return sign_ < 0 ? -sum : sum;
+}
+
+// Conversion to string
+PeBigIntBinary::operator std::string() const
+{
+    std::string str(toCharsSize(), '\0');
+    str.resize(toChars(&str[0]));
+
+    return str;
+}
+
+// Write this number's decimal representation to <buffer>, which must have
+// room for at least toCharsSize() characters. No null terminator is written.
+// Returns the number of characters written.
+size_t PeBigIntBinary::toChars(char* buffer) const
+{
+    std::vector<PeUint> chunks = toDecimalChunks();
+    char*               out    = buffer;
+
+    // Write sign if negative
+    if ( sign_ < 0 ) {
+        *out++ = '-';
+    }
+
+    // Most significant chunk without zero padding
+    char   top_digits[kDecimalChunkPower];
+    PeUint top_chunk = chunks.back();
+    size_t n_top     = 0;
+
+    do {
+        top_digits[n_top++] = (char)('0' + top_chunk % 10);
+        top_chunk /= 10;
+    } while ( top_chunk > 0 );
+
+    while ( n_top > 0 ) {
+        *out++ = top_digits[--n_top];
+    }
+
+    // Remaining chunks zero padded, written as 3 + 8 + 8 digits
+    for ( auto i_chunk = chunks.rbegin() + 1; i_chunk != chunks.rend(); ++i_chunk ) {
+        PeUint chunk = *i_chunk;
+
+        limbs::FormatLimb(chunk % limbs::kBase, out + 11);
+        chunk /= limbs::kBase;
+        limbs::FormatLimb(chunk % limbs::kBase, out + 3);
+        chunk /= limbs::kBase;
+
+        out[2] = (char)('0' + chunk % 10);
+        out[1] = (char)('0' + chunk / 10 % 10);
+        out[0] = (char)('0' + chunk / 100);
+        out += kDecimalChunkPower;
+    }
+
+    return out - buffer;
+}
+
+// Upper bound on the characters written by toChars().
+// Each 64 bit limb holds at most 20 decimal digits.
+size_t PeBigIntBinary::toCharsSize() const
+{
+    return (sign_ < 0 ? 1 : 0) + 20 * limbs_.size();
+}
+
+// Convenience function to test if value is zero
+bool PeBigIntBinary::isZero() const
+{
+    return (limbs_.size() == 1) && (limbs_[0] == 0);
+}
+
+// Divide this number by rhs, leaving the quotient in this number and
+// storing the remainder in <remainder>
+PeBigIntBinary& PeBigIntBinary::divmod(const PeBigIntBinary& rhs, PeBigIntBinary& remainder)
+{
+    // Record signs first in case rhs and remainder are the same object
+    int numerator_sign   = sign_;
+    int denominator_sign = rhs.sign_;
+
+    absDivModEq(rhs, &remainder);
+
+    sign_           = isZero() ? 1 : numerator_sign * denominator_sign;
+    remainder.sign_ = remainder.isZero() ? 1 : numerator_sign;
+
+    return *this;
+}
+
+// Raise number to the power n by binary exponentiation
+PeBigIntBinary& PeBigIntBinary::power(PeUint exponent)
+{
+    PeBigIntBinary result(1);
+
+    while ( exponent > 0 ) {
+        if ( math::IsOdd(exponent) ) {
+            result *= *this;
+        }
+
+        exponent /= 2; // Integer division
+        if ( exponent > 0 ) {
+            square();
+        }
+    }
+
+    *this = std::move(result);
+
+    return *this;
+}
+
+// Radix shift by whole limbs, i.e. multiply/divide by 2^(64n)
+PeBigIntBinary& PeBigIntBinary::radixShift(PeInt n)
+{
+    if ( isZero() ) {
+        return *this;
+    }
+
+    // Right shift of more than limb size sets number to zero
+    if ( (PeInt)limbs_.size() + n <= 0 ) {
+        limbs_.assign(1, 0);
+        sign_ = 1;
+    } else if ( n > 0 ) {
+        limbs_.insert(limbs_.begin(), n, 0);
+    } else if ( n < 0 ) {
+        limbs_.erase(limbs_.begin(), limbs_.begin() - n);
+    }
+
+    return *this;
+}
+
+// Reverse this number's decimal digits, keeping the sign
+PeBigIntBinary& PeBigIntBinary::reverseDigits()
+{
+    int sign = sign_;
+
+    std::string digits = static_cast<std::string>(*this);
+    if ( sign < 0 ) {
+        digits.erase(0, 1);
+    }
+    std::reverse(digits.begin(), digits.end());
+
+    sign_ = 1;
+    limbs_.clear();
+    fromString(digits);
+
+    if ( !isZero() ) {
+        sign_ = sign;
+    }
+
+    return *this;
+}
+
+// Square this number i.e. n = n * n
+PeBigIntBinary& PeBigIntBinary::square()
+{
+    return operator*=(*this);
+}
+
+// Return the sum of this number's decimal digits (ignores sign)
+PeBigIntBinary PeBigIntBinary::sumDigits()
+{
+    PeUint digit_sum = 0;
+
+    for ( const auto& chunk: toDecimalChunks() ) {
+        digit_sum += math::SumDigits(chunk);
+    }
+
+    return PeBigIntBinary(digit_sum);
+}
+
+// Helper functions for conversion from numeric types
+
+// Non-integer floats are rounded
+void PeBigIntBinary::fromFloating(long double val)
+{
+    // Sign check
+    if ( val < 0.0 ) {
+        sign_ = -1;
+        val   = -val;
+    }
+
+    val                   = roundl(val);
+    long double base_cast = ldexpl(1.0, 64);
+    while ( val >= base_cast ) {
+        limbs_.push_back((PeUint)fmodl(val, base_cast));
+        val = floorl(val / base_cast);
+    }
+    limbs_.push_back((PeUint)val);
+
+    popLeadingZeros();
+}
+
+void PeBigIntBinary::fromSigned(PeInt val)
+{
+    // Check for negative, converting via unsigned so INTMAX_MIN is safe
+    if ( val < 0 ) {
+        fromUnsigned(0ull - (PeUint)val);
+        sign_ = -1;
+    } else {
+        fromUnsigned((PeUint)val);
+    }
+}
+
+void PeBigIntBinary::fromUnsigned(PeUint val)
+{
+    limbs_.assign(1, val);
+}
+
+// String must be of the form [-+]?[0-9]+([eE][0-9]+)?, as for PeBigInt.
+// Invalid strings will be ignored and the value will be initialised to zero.
+// The mantissa is read 19 digits at a time and the chunks combined by
+// divide and conquer, then any exponent is applied as a multiplication by
+// a power of ten.
+void PeBigIntBinary::fromString(const std::string& valstr)
+{
+    size_t pos = 0;
+    int    sign = 1;
+
+    // Optional sign
+    if ( (pos < valstr.size()) && ((valstr[pos] == '-') || (valstr[pos] == '+')) ) {
+        sign = valstr[pos] == '-' ? -1 : 1;
+        ++pos;
+    }
+
+    // The mantissa runs to an exponent marker or the end of the string
+    const size_t mantissa_start = pos;
+    size_t       mantissa_end   = valstr.find_first_of("eE", pos);
+    bool         has_exponent   = mantissa_end != std::string::npos;
+
+    if ( !has_exponent ) {
+        mantissa_end = valstr.size();
+    }
+
+    const size_t exponent_start = has_exponent ? mantissa_end + 1 : valstr.size();
+    const size_t exponent_end   = valstr.size();
+
+    // Validate both digit runs. An exponent marker must be followed by digits.
+    bool is_valid = (mantissa_end > mantissa_start) &&
+                    limbs::AllDigits(valstr.data() + mantissa_start, mantissa_end - mantissa_start) &&
+                    (!has_exponent || ((exponent_start < exponent_end) &&
+                                       limbs::AllDigits(valstr.data() + exponent_start, exponent_end - exponent_start)));
+
+    // Invalid initialiser string, set to zero and return
+    if ( !is_valid ) {
+        limbs_.assign(1, 0);
+        return;
+    }
+
+    // Mantissa, read in chunks of kDecimalChunkPower digits from the least
+    // significant end, each chunk being 3 + 8 digits + 8 digits
+    std::vector<PeUint> chunks;
+    chunks.reserve((mantissa_end - mantissa_start) / kDecimalChunkPower + 1);
+
+    const char* str = valstr.data();
+    size_t      i   = mantissa_end;
+
+    for ( ; i - mantissa_start >= kDecimalChunkPower; i -= kDecimalChunkPower ) {
+        const char* chunk_str = str + i - kDecimalChunkPower;
+        PeUint      chunk_val = 100 * (PeUint)(chunk_str[0] - '0') + 10 * (PeUint)(chunk_str[1] - '0') +
+                           (PeUint)(chunk_str[2] - '0');
+
+        chunk_val = chunk_val * limbs::kBase + limbs::ParseLimb(chunk_str + 3);
+        chunk_val = chunk_val * limbs::kBase + limbs::ParseLimb(chunk_str + 11);
+        chunks.push_back(chunk_val);
+    }
+
+    // Remaining (most significant) digits
+    if ( i > mantissa_start ) {
+        PeUint chunk_val = 0;
+        for ( size_t j = mantissa_start; j < i; ++j ) {
+            chunk_val = 10 * chunk_val + (PeUint)(str[j] - '0');
+        }
+        chunks.push_back(chunk_val);
+    }
+
+    fromDecimalChunks(chunks.data(), chunks.size(), decimalChunkPowers(chunks.size()));
+
+    // Apply exponent as a multiplication by a power of ten
+    if ( has_exponent ) {
+        PeUint exp_value = std::stoull(valstr.substr(exponent_start, exponent_end - exponent_start));
+
+        if ( (exp_value > 0) && !isZero() ) {
+            PeBigIntBinary scale(10);
+            scale.power(exp_value);
+            absMultEq(scale);
+        }
+    }
+
+    sign_ = isZero() ? 1 : sign;
+}
+
+// Helper functions for operator overloading.
+// These typically work with the absolute value
+// of the number.
+
+// Comparison
+bool PeBigIntBinary::absEq(const PeBigIntBinary& rhs) const
+{
+    return limbs_ == rhs.limbs_;
+}
+
+bool PeBigIntBinary::absLt(const PeBigIntBinary& rhs) const
+{
+    // Different numbers of limbs decide it straight away
+    if ( limbs_.size() != rhs.limbs_.size() ) {
+        return limbs_.size() < rhs.limbs_.size();
+    }
+
+    // Otherwise compare from most to least significant limb
+    for ( size_t i = limbs_.size(); i-- > 0; ) {
+        if ( limbs_[i] != rhs.limbs_[i] ) {
+            return limbs_[i] < rhs.limbs_[i];
+        }
+    }
+
+    // If we reach here, the values are equal
+    return false;
+}
+
+// Arithmetic
+PeBigIntBinary& PeBigIntBinary::absPlusEq(const PeBigIntBinary& rhs)
+{
+    // Make room for the longer operand plus a carry limb
+    const size_t rhs_size = rhs.limbs_.size();
+    limbs_.resize(std::max(limbs_.size(), rhs_size) + 1, 0);
+
+    BinaryAddTo(limbs_.data(), limbs_.size(), rhs.limbs_.data(), rhs_size);
+    popLeadingZeros();
+
+    return *this;
+}
+
+// Note rhs must be smaller than this otherwise undefined
+// behaviour occurs
+PeBigIntBinary& PeBigIntBinary::absMinusEq(const PeBigIntBinary& rhs)
+{
+    BinarySubtractFrom(limbs_.data(), limbs_.size(), rhs.limbs_.data(), rhs.limbs_.size());
+    popLeadingZeros();
+
+    return *this;
+}
+
+PeBigIntBinary& PeBigIntBinary::absMultEq(const PeBigIntBinary& rhs)
+{
+    // The result is written to a separate array, so rhs may alias this
+    std::vector<PeUint> res(limbs_.size() + rhs.limbs_.size());
+    BinaryMultiply(limbs_.data(), limbs_.size(), rhs.limbs_.data(), rhs.limbs_.size(), res.data());
+
+    limbs_ = std::move(res);
+    popLeadingZeros();
+
+    return *this;
+}
+
+// Long division of absolute values, optionally storing the remainder.
+// Throws runtime_error if rhs is zero.
+PeBigIntBinary& PeBigIntBinary::absDivModEq(const PeBigIntBinary& rhs, PeBigIntBinary* remainder)
+{
+    // Divison by zero check
+    if ( rhs.isZero() ) {
+        throw std::runtime_error("PeBigIntBinary: Division by zero.");
+    }
+
+    // Smaller numerator: the quotient is zero and the remainder is this value
+    if ( absLt(rhs) ) {
+        if ( remainder ) {
+            remainder->limbs_ = limbs_;
+            remainder->sign_  = 1;
+        }
+        limbs_.assign(1, 0);
+
+        return *this;
+    }
+
+    const size_t        nu = limbs_.size(), nv = rhs.limbs_.size();
+    std::vector<PeUint> quotient(nu - nv + 1), remainder_limbs(nv);
+
+    BinaryDivide(limbs_.data(), nu, rhs.limbs_.data(), nv, quotient.data(), remainder_limbs.data());
+
+    if ( remainder ) {
+        remainder->limbs_ = std::move(remainder_limbs);
+        remainder->sign_  = 1;
+        remainder->popLeadingZeros();
+    }
+
+    limbs_ = std::move(quotient);
+    popLeadingZeros();
+
+    return *this;
+}
+
+// this = this * multiplier + addend, for single limb values
+PeBigIntBinary& PeBigIntBinary::absShortMultAddEq(PeUint multiplier, PeUint addend)
+{
+    PeUint carry = addend;
+
+    for ( auto& limb: limbs_ ) {
+        PeUint hi;
+        PeUint lo = intrinsics::MulWide(limb, multiplier, hi);
+
+        lo += carry;
+        hi += lo < carry;
+        limb  = lo;
+        carry = hi;
+    }
+
+    if ( carry ) {
+        limbs_.push_back(carry);
+    }
+
+    popLeadingZeros();
+
+    return *this;
+}
+
+// this = this / denominator, returning the remainder
+PeUint PeBigIntBinary::absShortDivEq(PeUint denominator)
+{
+    PeUint rem = 0;
+
+    for ( size_t i = limbs_.size(); i-- > 0; ) {
+        limbs_[i] = intrinsics::DivWide(rem, limbs_[i], denominator, rem);
+    }
+
+    popLeadingZeros();
+
+    return rem;
+}
+
+// Decimal conversion to base 10^19 chunks.
+// This is the only place decimal digits are produced.
+//
+// Small values use repeated short division by 10^19. Larger values are
+// split in half by a precomputed power (10^19)^(2^k) and each half is
+// converted recursively, so the work is dominated by a few large
+// divisions rather than one short division per chunk over the whole value.
+std::vector<PeUint> PeBigIntBinary::toDecimalChunks() const
+{
+    std::vector<PeUint> chunks;
+
+    // Each limb gives just over 19 decimal digits
+    const size_t n_chunks = limbs_.size() * 64 / 63 + 1;
+    chunks.reserve(n_chunks);
+
+    appendDecimalChunks(decimalChunkPowers(n_chunks), std::string::npos, false, chunks);
+
+    // Padding can leave zero chunks at the top; keep at least one
+    while ( (chunks.size() > 1) && (chunks.back() == 0) ) {
+        chunks.pop_back();
+    }
+
+    return chunks;
+}
+
+// Powers (10^19)^(2^k) for splitting up to n_chunks chunks, stopping once
+// the next power would cover the whole value
+std::vector<PeBigIntBinary> PeBigIntBinary::decimalChunkPowers(size_t n_chunks)
+{
+    std::vector<PeBigIntBinary> powers;
+
+    if ( n_chunks <= kDecimalSplitThreshold ) {
+        return powers;
+    }
+
+    powers.push_back(PeBigIntBinary(kDecimalChunk));
+    for ( size_t span = 1; 2 * span < n_chunks; span *= 2 ) {
+        PeBigIntBinary next(powers.back());
+        next.square();
+        powers.push_back(std::move(next));
+    }
+
+    return powers;
+}
+
+// Append this (non-negative) value's decimal chunks, splitting by
+// powers[level] and below. A level of npos picks the largest useful power.
+void PeBigIntBinary::appendDecimalChunks(const std::vector<PeBigIntBinary>& powers, size_t level, bool pad,
+                                         std::vector<PeUint>& chunks) const
+{
+    if ( level == std::string::npos ) {
+        level = powers.size();
+        while ( (level > 0) && absLt(powers[level - 1]) ) {
+            --level;
+        }
+        level = level > 0 ? level - 1 : std::string::npos;
+    }
+
+    // Small values (or the bottom of the recursion): short division
+    if ( (level == std::string::npos) || (limbs_.size() <= kDecimalSplitThreshold) ) {
+        const size_t   start = chunks.size();
+        PeBigIntBinary tmp(*this);
+
+        do {
+            chunks.push_back(tmp.absShortDivEq(kDecimalChunk));
+        } while ( !tmp.isZero() );
+
+        // Lower halves must fill exactly 2^(level + 1) chunks
+        if ( pad ) {
+            const size_t width = level == std::string::npos ? 1 : size_t(2) << level;
+            chunks.resize(start + width, 0);
+        }
+
+        return;
+    }
+
+    // Split into high and low halves of 2^level chunks each
+    PeBigIntBinary high(*this), low;
+    high.absDivModEq(powers[level], &low);
+
+    const size_t next_level = level > 0 ? level - 1 : std::string::npos;
+    low.appendDecimalChunks(powers, next_level, true, chunks);
+    high.appendDecimalChunks(powers, next_level, pad, chunks);
+}
+
+// Set this value from <n> base 10^19 chunks, least significant first.
+// The chunks are split at the largest power of two below n, and the halves
+// combined as high * (10^19)^(2^k) + low.
+void PeBigIntBinary::fromDecimalChunks(const PeUint* chunks, size_t n, const std::vector<PeBigIntBinary>& powers)
+{
+    if ( n <= kDecimalSplitThreshold ) {
+        limbs_.assign(1, 0);
+        for ( size_t i = n; i-- > 0; ) {
+            absShortMultAddEq(kDecimalChunk, chunks[i]);
+        }
+
+        return;
+    }
+
+    size_t level = 0;
+    while ( (size_t(2) << level) < n ) {
+        ++level;
+    }
+
+    const size_t   split = size_t(1) << level;
+    PeBigIntBinary low;
+
+    low.fromDecimalChunks(chunks, split, powers);
+    fromDecimalChunks(chunks + split, n - split, powers);
+
+    absMultEq(powers[level]);
+    absPlusEq(low);
+}
+
+// Remove any leading zeros, keeping at least one limb.
+// Zero is always stored with a positive sign.
+void PeBigIntBinary::popLeadingZeros()
+{
+    while ( (limbs_.size() > 1) && (limbs_.back() == 0) ) {
+        limbs_.pop_back();
+    }
+
+    if ( limbs_.empty() ) {
+        limbs_.push_back(0);
+    }
+
+    if ( isZero() ) {
+        sign_ = 1;
+    }
+}
+
+} // namespace pe
@@ -0,0 +1,143 @@
+// Copyright 2020-2023 Paul Robertson
+//
+// PeBigIntModular.cpp
+//
+// Modular arithmetic on PeBigInt with a fixed modulus
+
+#include "PeBigIntModular.h"
+
+#include <limits>
+#include <stdexcept>
+
+namespace pe
+{
+PeBigIntModular::PeBigIntModular(const PeBigInt& modulus) : modulus_(modulus)
+{
+    if ( modulus_ <= PeBigInt(0) ) {
+        throw std::runtime_error("PeBigIntModular: Modulus must be positive.");
+    }
+
+    // Number of limbs, from the number of decimal digits
+    n_ = (modulus_.numDigits() + limbs::kBasePower - 1) / limbs::kBasePower;
+
+    bound_ = PeBigInt(1);
+    bound_.radixShift((PeInt)(2 * n_));
+
+    mu_ = bound_;
+    mu_ /= modulus_;
+}
+
+const PeBigInt& PeBigIntModular::modulus() const
+{
+    return modulus_;
+}
+
+// Values already in range are returned as they are. Other non-negative
+// values below kBase^(2n) (which includes any product of two reduced values)
+// use Barrett reduction, and anything else falls back to a long division.
+PeBigInt PeBigIntModular::reduce(const PeBigInt& x) const
+{
+    if ( x >= PeBigInt(0) ) {
+        if ( x < modulus_ ) {
+            return x;
+        }
+        if ( x < bound_ ) {
+            return barrettReduce(x);
+        }
+    }
+
+    PeBigInt r = x;
+    r %= modulus_;
+
+    // The remainder takes the sign of x, so bring negatives into range
+    if ( r < PeBigInt(0) ) {
+        r += modulus_;
+    }
+
+    return r;
+}
+
+PeBigInt PeBigIntModular::mulMod(const PeBigInt& a, const PeBigInt& b) const
+{
+    PeBigInt product = reduce(a) * reduce(b);
+    return barrettReduce(product);
+}
+
+// Binary exponentiation, squaring from the least significant bit up
+PeBigInt PeBigIntModular::powMod(const PeBigInt& base, PeUint exponent) const
+{
+    PeBigInt result = reduce(PeBigInt(1));
+    PeBigInt square = reduce(base);
+
+    while ( exponent > 0 ) {
+        if ( math::IsOdd(exponent) ) {
+            result = mulMod(result, square);
+        }
+
+        exponent /= 2; // Integer division
+        if ( exponent > 0 ) {
+            square = mulMod(square, square);
+        }
+    }
+
+    return result;
+}
+
+// Exponents beyond PeUint are read one decimal digit at a time from the most
+// significant end: result = result^10 * base^digit for each digit, using a
+// table of base^0 to base^9. This costs about as many multiplications per
+// digit as binary exponentiation does per log2(10) bits, without needing the
+// exponent in binary.
+PeBigInt PeBigIntModular::powMod(const PeBigInt& base, const PeBigInt& exponent) const
+{
+    if ( exponent < PeBigInt(0) ) {
+        throw std::runtime_error("PeBigIntModular: Negative exponent.");
+    }
+
+    if ( exponent <= PeBigInt(std::numeric_limits<PeUint>::max()) ) {
+        return powMod(base, (PeUint)exponent);
+    }
+
+    PeBigInt powers[10];
+    powers[0] = reduce(PeBigInt(1));
+    powers[1] = reduce(base);
+    for ( int d = 2; d < 10; ++d ) {
+        powers[d] = mulMod(powers[d - 1], powers[1]);
+    }
+
+    PeBigInt result = powers[0];
+
+    for ( int digit: exponent.digits() ) {
+        // result^10 = ((result^2)^2 * result)^2
+        PeBigInt result_4 = mulMod(result, result);
+        result_4          = mulMod(result_4, result_4);
+        result            = mulMod(result_4, result);
+        result            = mulMod(result, result);
+
+        result = mulMod(result, powers[digit]);
+    }
+
+    return result;
+}
+
+// Barrett reduction (Handbook of Applied Cryptography, algorithm 14.42).
+// With B = kBase, the quotient estimate
+//    q = floor(floor(x / B^(n-1)) * mu / B^(n+1))
+// is at most two less than floor(x / m), so x - q * m needs at most two
+// further subtractions of m.
+PeBigInt PeBigIntModular::barrettReduce(const PeBigInt& x) const
+{
+    PeBigInt q = x;
+    q.radixShift(-(PeInt)(n_ - 1));
+    q *= mu_;
+    q.radixShift(-(PeInt)(n_ + 1));
+
+    PeBigInt r = x - q * modulus_;
+    while ( r >= modulus_ ) {
+        r -= modulus_;
+    }
+
+    return r;
+}
+
+} // namespace pe
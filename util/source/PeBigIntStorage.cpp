@@ -0,0 +1,445 @@
+// Copyright 2020-2023 Paul Robertson
+//
+// PeBigIntStorage.cpp
+//
+// Binary files of PeBigInt values, and zero copy loading by memory mapping
+
+#include "PeBigIntStorage.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace pe
+{
+// File header fields, see PeBigIntStorage.h
+const char   kBigIntFileMagic[8] = { 'P', 'E', 'B', 'I', 'G', 'I', 'N', 'T' };
+const size_t kBigIntHeaderBytes  = 24;
+
+// Zero may be held with no limbs, so views of it use this one
+const PeUint kZeroLimb = 0;
+
+// Limbs read from a stream at a time
+const size_t kReadChunkLimbs = 65536;
+
+// Views
+
+PeBigIntView::PeBigIntView(const PeBigInt& value) :
+    sign_(value.sign_), limbs_(value.digits_.data()), size_(value.digits_.size()), offset_(value.offset_)
+{
+    if ( size_ == 0 ) {
+        limbs_ = &kZeroLimb;
+        size_  = 1;
+    }
+}
+
+bool PeBigIntView::isZero() const
+{
+    return (size_ == 1) && (limbs_[0] == 0);
+}
+
+size_t PeBigIntView::numDigits() const
+{
+    size_t top_digits = 1;
+    while ( (top_digits < limbs::kBasePower) && (limbs_[size_ - 1] >= kLimbDigitPowers[top_digits]) ) {
+        ++top_digits;
+    }
+
+    return (size_ + offset_ - 1) * limbs::kBasePower + top_digits;
+}
+
+PeBigIntDigits PeBigIntView::digits() const
+{
+    return PeBigIntDigits(limbs_, numDigits(), offset_ * limbs::kBasePower);
+}
+
+// Throws runtime_error if the limbs aren't a valid number. Checking costs
+// no more than the copy.
+PeBigInt PeBigIntView::value() const
+{
+    for ( size_t i = 0; i < size_; ++i ) {
+        if ( limbs_[i] >= limbs::kBase ) {
+            throw std::runtime_error("PeBigIntView: Limb out of range.");
+        }
+    }
+    if ( (size_ > 1) && (limbs_[size_ - 1] == 0) ) {
+        throw std::runtime_error("PeBigIntView: Leading zero limb.");
+    }
+
+    PeBigInt result;
+    result.sign_   = isZero() ? 1 : sign_;
+    result.offset_ = offset_;
+    result.digits_.resize(size_);
+    std::copy(limbs_, limbs_ + size_, result.digits_.data());
+
+    return result;
+}
+
+bool PeBigIntView::operator==(const PeBigIntView& rhs) const
+{
+    return (sign_ == rhs.sign_) &&
+           (limbs::CompareOffset(limbs_, size_, offset_, rhs.limbs_, rhs.size_, rhs.offset_) == 0);
+}
+
+bool PeBigIntView::operator!=(const PeBigIntView& rhs) const
+{
+    return !operator==(rhs);
+}
+
+// Writing
+
+namespace
+{
+template <typename T>
+void WriteField(std::ostream& out, const T& field)
+{
+    out.write(reinterpret_cast<const char*>(&field), sizeof(T));
+}
+} // namespace
+
+// Throws runtime_error if writing fails.
+void WriteBigInts(std::ostream& out, const std::vector<PeBigInt>& values)
+{
+    std::vector<PeBigIntView> views(values.begin(), values.end());
+
+    out.write(kBigIntFileMagic, sizeof(kBigIntFileMagic));
+    WriteField(out, (std::uint32_t)kBigIntFileVersion);
+    WriteField(out, (std::uint32_t)limbs::kBasePower);
+    WriteField(out, (PeUint)views.size());
+
+    // Each record is its length followed by its limbs, with any limb
+    // offset written out as zero limbs
+    PeUint offset = kBigIntHeaderBytes + (views.size() + 1) * sizeof(PeUint);
+    for ( const PeBigIntView& view: views ) {
+        WriteField(out, offset);
+        offset += (view.offset() + view.size() + 1) * sizeof(PeUint);
+    }
+    WriteField(out, offset);
+
+    for ( const PeBigIntView& view: views ) {
+        WriteField(out, (PeInt)(view.offset() + view.size()) * view.sign());
+        for ( size_t i = 0; i < view.offset(); ++i ) {
+            WriteField(out, kZeroLimb);
+        }
+        out.write(reinterpret_cast<const char*>(view.limbs()), view.size() * sizeof(PeUint));
+    }
+
+    if ( !out ) {
+        throw std::runtime_error("PeBigIntStorage: Write failed.");
+    }
+}
+
+void SaveBigInts(const std::string& path, const std::vector<PeBigInt>& values)
+{
+    std::ofstream out(path, std::ios::binary);
+    if ( !out ) {
+        throw std::runtime_error("PeBigIntStorage: Can't open " + path + " for writing.");
+    }
+
+    WriteBigInts(out, values);
+}
+
+void SaveBigInt(const std::string& path, const PeBigInt& value)
+{
+    SaveBigInts(path, std::vector<PeBigInt>(1, value));
+}
+
+// Reading
+
+namespace
+{
+template <typename T>
+T ReadField(std::istream& in)
+{
+    T field;
+    if ( !in.read(reinterpret_cast<char*>(&field), sizeof(T)) ) {
+        throw std::runtime_error("PeBigIntStorage: Unexpected end of file.");
+    }
+
+    return field;
+}
+
+// Check the fixed size header at the start of <header>, returning the
+// number of values
+PeUint CheckHeader(const unsigned char* header)
+{
+    std::uint32_t version;
+    std::uint32_t limb_digits;
+    PeUint        count;
+    std::memcpy(&version, header + 8, sizeof(version));
+    std::memcpy(&limb_digits, header + 12, sizeof(limb_digits));
+    std::memcpy(&count, header + 16, sizeof(count));
+
+    if ( std::memcmp(header, kBigIntFileMagic, sizeof(kBigIntFileMagic)) != 0 ) {
+        throw std::runtime_error("PeBigIntStorage: Not a PeBigInt file.");
+    }
+    if ( version != kBigIntFileVersion ) {
+        throw std::runtime_error("PeBigIntStorage: Unsupported file version.");
+    }
+    if ( limb_digits != limbs::kBasePower ) {
+        throw std::runtime_error("PeBigIntStorage: File has a different limb base.");
+    }
+
+    return count;
+}
+
+// Test whether a record of <record_bytes> holds a length word and exactly
+// <size> limbs, without overflowing for corrupt sizes
+bool RecordFits(PeUint record_bytes, PeUint size)
+{
+    return (record_bytes % sizeof(PeUint) == 0) && (record_bytes / sizeof(PeUint) - 1 == size);
+}
+
+// Read <size> limbs a chunk at a time, so a corrupt size runs into the end
+// of the stream instead of allocating for limbs that aren't there
+std::vector<PeUint> ReadLimbs(std::istream& in, PeUint size)
+{
+    std::vector<PeUint> limbs;
+
+    while ( limbs.size() < size ) {
+        const size_t done  = limbs.size();
+        const size_t chunk = (size_t)std::min<PeUint>(size - done, kReadChunkLimbs);
+
+        limbs.resize(done + chunk);
+        if ( !in.read(reinterpret_cast<char*>(limbs.data() + done), chunk * sizeof(PeUint)) ) {
+            throw std::runtime_error("PeBigIntStorage: Unexpected end of file.");
+        }
+    }
+
+    return limbs;
+}
+} // namespace
+
+// Throws runtime_error if the stream isn't a valid file.
+std::vector<PeBigInt> ReadBigInts(std::istream& in)
+{
+    unsigned char header[kBigIntHeaderBytes];
+    if ( !in.read(reinterpret_cast<char*>(header), sizeof(header)) ) {
+        throw std::runtime_error("PeBigIntStorage: Unexpected end of file.");
+    }
+    const PeUint count = CheckHeader(header);
+
+    // Each value needs an index entry and a record of at least two words,
+    // so a larger count is corrupt, and would overflow the offsets below
+    if ( count > (std::numeric_limits<PeUint>::max() - kBigIntHeaderBytes) / (3 * sizeof(PeUint)) ) {
+        throw std::runtime_error("PeBigIntStorage: Corrupt index.");
+    }
+
+    std::vector<PeUint> index;
+    for ( PeUint i = 0; i <= count; ++i ) {
+        index.push_back(ReadField<PeUint>(in));
+    }
+
+    // The records follow the index in order, each holding at least its
+    // length word
+    if ( index[0] != kBigIntHeaderBytes + (count + 1) * sizeof(PeUint) ) {
+        throw std::runtime_error("PeBigIntStorage: Corrupt index.");
+    }
+    for ( PeUint i = 0; i < count; ++i ) {
+        if ( (index[i + 1] < index[i]) || (index[i + 1] - index[i] < sizeof(PeUint)) ) {
+            throw std::runtime_error("PeBigIntStorage: Corrupt index.");
+        }
+    }
+
+    std::vector<PeBigInt> values;
+    values.reserve(count);
+
+    for ( PeUint i = 0; i < count; ++i ) {
+        const PeInt  length = ReadField<PeInt>(in);
+        const PeUint size   = length < 0 ? 0 - (PeUint)length : (PeUint)length;
+
+        if ( (size == 0) || !RecordFits(index[i + 1] - index[i], size) ) {
+            throw std::runtime_error("PeBigIntStorage: Corrupt index.");
+        }
+
+        // The index itself may lie about the file's length, so the limbs
+        // are still read in chunks
+        const std::vector<PeUint> limbs = ReadLimbs(in, size);
+
+        // value() rejects out of range limbs and leading zero limbs
+        values.push_back(PeBigIntView(length < 0 ? -1 : 1, limbs.data(), size).value());
+    }
+
+    return values;
+}
+
+// Memory mapped files
+
+// Throws runtime_error if the file can't be opened or isn't valid
+PeBigIntMappedFile::PeBigIntMappedFile(const std::string& path) :
+    data_(nullptr), bytes_(0), count_(0), index_(nullptr)
+{
+#if defined(_WIN32)
+    file_    = INVALID_HANDLE_VALUE;
+    mapping_ = nullptr;
+
+    HANDLE        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                     FILE_ATTRIBUTE_NORMAL, nullptr);
+    LARGE_INTEGER file_size;
+    if ( (file == INVALID_HANDLE_VALUE) || !GetFileSizeEx(file, &file_size) ) {
+        if ( file != INVALID_HANDLE_VALUE ) {
+            CloseHandle(file);
+        }
+        throw std::runtime_error("PeBigIntMappedFile: Can't open " + path + ".");
+    }
+    file_  = file;
+    bytes_ = (size_t)file_size.QuadPart;
+
+    if ( bytes_ >= kBigIntHeaderBytes ) {
+        mapping_ = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if ( mapping_ ) {
+            data_ = static_cast<const unsigned char*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+        }
+        if ( !data_ ) {
+            unmap();
+            throw std::runtime_error("PeBigIntMappedFile: Can't map " + path + ".");
+        }
+    }
+#else
+    const int file = open(path.c_str(), O_RDONLY);
+    struct stat file_stat;
+    if ( (file < 0) || (fstat(file, &file_stat) != 0) ) {
+        if ( file >= 0 ) {
+            close(file);
+        }
+        throw std::runtime_error("PeBigIntMappedFile: Can't open " + path + ".");
+    }
+    bytes_ = (size_t)file_stat.st_size;
+
+    // The mapping stays valid once the file is closed
+    if ( bytes_ >= kBigIntHeaderBytes ) {
+        void* data = mmap(nullptr, bytes_, PROT_READ, MAP_PRIVATE, file, 0);
+        if ( data != MAP_FAILED ) {
+            data_ = static_cast<const unsigned char*>(data);
+        }
+    }
+    close(file);
+
+    if ( (bytes_ >= kBigIntHeaderBytes) && !data_ ) {
+        throw std::runtime_error("PeBigIntMappedFile: Can't map " + path + ".");
+    }
+#endif
+
+    try {
+        validate();
+    } catch ( ... ) {
+        unmap();
+        throw;
+    }
+}
+
+PeBigIntMappedFile::~PeBigIntMappedFile()
+{
+    unmap();
+}
+
+size_t PeBigIntMappedFile::size() const
+{
+    return count_;
+}
+
+PeBigIntView PeBigIntMappedFile::operator[](size_t index) const
+{
+    const PeUint* record = reinterpret_cast<const PeUint*>(data_ + index_[index]);
+    const PeInt   length = (PeInt)record[0];
+
+    return PeBigIntView(length < 0 ? -1 : 1, record + 1, (size_t)(length < 0 ? -length : length));
+}
+
+// Throws runtime_error if out of range.
+PeBigIntView PeBigIntMappedFile::at(size_t index) const
+{
+    if ( index >= count_ ) {
+        throw std::runtime_error("PeBigIntMappedFile: Index out of range.");
+    }
+
+    return operator[](index);
+}
+
+std::vector<PeBigInt> PeBigIntMappedFile::values() const
+{
+    std::vector<PeBigInt> result;
+    result.reserve(count_);
+
+    for ( size_t i = 0; i < count_; ++i ) {
+        result.push_back(operator[](i).value());
+    }
+
+    return result;
+}
+
+// Checks everything that operator[] relies on, so that no view can reach
+// outside the mapping. This reads each record's length but not its limbs.
+void PeBigIntMappedFile::validate()
+{
+    if ( bytes_ < kBigIntHeaderBytes ) {
+        throw std::runtime_error("PeBigIntMappedFile: File too short.");
+    }
+
+    const PeUint count       = CheckHeader(data_);
+    const PeUint index_slots = (bytes_ - kBigIntHeaderBytes) / sizeof(PeUint);
+    if ( count >= index_slots ) {
+        throw std::runtime_error("PeBigIntMappedFile: Corrupt index.");
+    }
+
+    count_ = (size_t)count;
+    index_ = reinterpret_cast<const PeUint*>(data_ + kBigIntHeaderBytes);
+
+    if ( index_[0] != kBigIntHeaderBytes + (count + 1) * sizeof(PeUint) || (index_[count] > bytes_) ) {
+        throw std::runtime_error("PeBigIntMappedFile: Corrupt index.");
+    }
+
+    for ( size_t i = 0; i < count_; ++i ) {
+        // Each record must hold its length word, which is read here
+        if ( (index_[i + 1] < index_[i] + sizeof(PeUint)) || (index_[i + 1] > index_[count]) ) {
+            throw std::runtime_error("PeBigIntMappedFile: Corrupt index.");
+        }
+
+        const PeInt  length = (PeInt)*reinterpret_cast<const PeUint*>(data_ + index_[i]);
+        const PeUint size   = length < 0 ? 0 - (PeUint)length : (PeUint)length;
+        if ( (size == 0) || !RecordFits(index_[i + 1] - index_[i], size) ) {
+            throw std::runtime_error("PeBigIntMappedFile: Corrupt record.");
+        }
+    }
+}
+
+void PeBigIntMappedFile::unmap()
+{
+#if defined(_WIN32)
+    if ( data_ ) {
+        UnmapViewOfFile(data_);
+    }
+    if ( mapping_ ) {
+        CloseHandle(mapping_);
+    }
+    if ( file_ != INVALID_HANDLE_VALUE ) {
+        CloseHandle(file_);
+    }
+    file_    = INVALID_HANDLE_VALUE;
+    mapping_ = nullptr;
+#else
+    if ( data_ ) {
+        munmap(const_cast<unsigned char*>(data_), bytes_);
+    }
+#endif
+    data_  = nullptr;
+    bytes_ = 0;
+    count_ = 0;
+}
+
+} // namespace pe
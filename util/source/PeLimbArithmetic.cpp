@@ -0,0 +1,1626 @@
+// Copyright 2020-2023 Paul Robertson
+//
+// PeLimbArithmetic.cpp
+//
+// Low level arithmetic on arrays of base 10^8 "limbs", as used by PeBigInt
+
+#include "PeLimbArithmetic.h"
+#include "PeLimbPool.h"
+#include "PeSmallVector.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <future>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define PE_LIMBS_SSE2
+#endif
+
+// AVX2 and SSE4.2 kernels are compiled for any x86 target and selected at
+// runtime, so GCC and Clang need them marked with their target instruction
+// set. MSVC allows the intrinsics anywhere.
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#include <immintrin.h>
+#define PE_LIMBS_X86
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define PE_TARGET(isa)
+#else
+#define PE_TARGET(isa) __attribute__((target(isa)))
+#endif
+#endif
+
+namespace pe
+{
+namespace limbs
+{
+// Number of rows the schoolbook method accumulates before carries must be
+// resolved. Each product is below kBase^2 = 10^16, so 1024 of them plus a
+// normalised limb stays below 2^64 (~1.8 * 10^19).
+const size_t kDeferredCarryRows = 1024;
+
+// Scratch limb arrays for the multiplication and division algorithms.
+// Short ones stay on the stack and longer ones recycle blocks through the
+// current thread's PeLimbPool, since the recursive algorithms create and
+// destroy many buffers of the same few sizes.
+typedef PeSmallVector<PeUint, 16, PeLimbPoolAllocator> ScratchLimbs;
+
+namespace
+{
+// A signed limb array used for the intermediate values of Toom-3,
+// which can be negative. Magnitudes are kept without leading zeros,
+// so zero is represented by an empty magnitude.
+struct SignedLimbs
+{
+    std::vector<PeUint> mag;
+    bool                negative = false;
+};
+} // namespace
+
+// Limb-wise addition, subtraction and comparison kernels.
+//
+// Each kernel works on two arrays of the same length <n>. The add and
+// subtract kernels take a carry (or borrow) in and return the carry out.
+// The SIMD versions add whole vectors of limbs at once and then fix up the
+// carries between lanes together: after the limb-wise sum, each lane's carry
+// out is known, and adding the carry in from the lane below can only carry
+// out again if that lane held exactly kBase - 1. That case is rare, so such
+// blocks are simply redone with the scalar kernel.
+
+namespace
+{
+typedef PeUint (*AddLimbsKernel)(PeUint* r, const PeUint* a, size_t n, PeUint carry);
+typedef int (*CompareLimbsKernel)(const PeUint* a, const PeUint* b, size_t n);
+
+// Below this many limbs the scalar kernels are called directly
+const size_t kSimdMinLimbs = 8;
+
+PeUint AddLimbsScalar(PeUint* r, const PeUint* a, size_t n, PeUint carry)
+{
+    for ( size_t i = 0; i < n; ++i ) {
+        PeUint sum = r[i] + a[i] + carry;
+        carry      = sum >= kBase;
+        r[i]       = sum - carry * kBase;
+    }
+
+    return carry;
+}
+
+PeUint SubtractLimbsScalar(PeUint* r, const PeUint* a, size_t n, PeUint borrow)
+{
+    for ( size_t i = 0; i < n; ++i ) {
+        PeUint sub = a[i] + borrow;
+        borrow     = r[i] < sub;
+        r[i]       = r[i] + borrow * kBase - sub;
+    }
+
+    return borrow;
+}
+
+// Compare from the most significant limb down
+int CompareLimbsScalar(const PeUint* a, const PeUint* b, size_t n)
+{
+    for ( size_t i = n; i-- > 0; ) {
+        if ( a[i] != b[i] ) {
+            return a[i] < b[i] ? -1 : 1;
+        }
+    }
+
+    return 0;
+}
+
+#if defined(PE_LIMBS_X86)
+// AVX2 kernels, four limbs per vector. Limbs are below 2^63, so the signed
+// 64 bit comparisons are safe.
+PE_TARGET("avx2") PeUint AddLimbsAvx2(PeUint* r, const PeUint* a, size_t n, PeUint carry)
+{
+    const __m256i base         = _mm256_set1_epi64x(kBase);
+    const __m256i base_minus_1 = _mm256_set1_epi64x(kBase - 1);
+    size_t        i            = 0;
+
+    for ( ; i + 4 <= n; i += 4 ) {
+        __m256i sum = _mm256_add_epi64(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(r + i)),
+                                       _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)));
+
+        // Carry out of each lane as a mask, and the lane reduced below kBase
+        __m256i carry_out = _mm256_cmpgt_epi64(sum, base_minus_1);
+        sum               = _mm256_sub_epi64(sum, _mm256_and_si256(carry_out, base));
+
+        // Carry in to each lane from the lane below (subtracting a mask adds 1)
+        __m256i carry_in = _mm256_permute4x64_epi64(carry_out, _MM_SHUFFLE(2, 1, 0, 3));
+        carry_in         = _mm256_blend_epi32(carry_in, _mm256_set1_epi64x(0 - (PeInt)carry), 0x03);
+        sum              = _mm256_sub_epi64(sum, carry_in);
+
+        if ( _mm256_movemask_epi8(_mm256_cmpeq_epi64(sum, base)) ) {
+            carry = AddLimbsScalar(r + i, a + i, 4, carry);
+        } else {
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(r + i), sum);
+            carry = (_mm256_movemask_pd(_mm256_castsi256_pd(carry_out)) >> 3) & 1;
+        }
+    }
+
+    return AddLimbsScalar(r + i, a + i, n - i, carry);
+}
+
+PE_TARGET("avx2") PeUint SubtractLimbsAvx2(PeUint* r, const PeUint* a, size_t n, PeUint borrow)
+{
+    const __m256i base     = _mm256_set1_epi64x(kBase);
+    const __m256i all_ones = _mm256_set1_epi64x(-1);
+    size_t        i        = 0;
+
+    for ( ; i + 4 <= n; i += 4 ) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(r + i));
+        __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+
+        // Borrow out of each lane as a mask, and the lane brought back above zero
+        __m256i borrow_out = _mm256_cmpgt_epi64(y, x);
+        __m256i diff       = _mm256_add_epi64(_mm256_sub_epi64(x, y), _mm256_and_si256(borrow_out, base));
+
+        // Borrow in to each lane from the lane below (adding a mask subtracts 1)
+        __m256i borrow_in = _mm256_permute4x64_epi64(borrow_out, _MM_SHUFFLE(2, 1, 0, 3));
+        borrow_in         = _mm256_blend_epi32(borrow_in, _mm256_set1_epi64x(0 - (PeInt)borrow), 0x03);
+        diff              = _mm256_add_epi64(diff, borrow_in);
+
+        if ( _mm256_movemask_epi8(_mm256_cmpeq_epi64(diff, all_ones)) ) {
+            borrow = SubtractLimbsScalar(r + i, a + i, 4, borrow);
+        } else {
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(r + i), diff);
+            borrow = (_mm256_movemask_pd(_mm256_castsi256_pd(borrow_out)) >> 3) & 1;
+        }
+    }
+
+    return SubtractLimbsScalar(r + i, a + i, n - i, borrow);
+}
+
+PE_TARGET("avx2") int CompareLimbsAvx2(const PeUint* a, const PeUint* b, size_t n)
+{
+    size_t i = n;
+
+    for ( ; i >= 4; i -= 4 ) {
+        __m256i equal = _mm256_cmpeq_epi64(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i - 4)),
+                                           _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i - 4)));
+
+        if ( _mm256_movemask_pd(_mm256_castsi256_pd(equal)) != 0xF ) {
+            return CompareLimbsScalar(a + i - 4, b + i - 4, 4);
+        }
+    }
+
+    return CompareLimbsScalar(a, b, i);
+}
+
+// SSE4.2 kernels, two limbs per vector
+PE_TARGET("sse4.2") PeUint AddLimbsSse42(PeUint* r, const PeUint* a, size_t n, PeUint carry)
+{
+    const __m128i base         = _mm_set1_epi64x(kBase);
+    const __m128i base_minus_1 = _mm_set1_epi64x(kBase - 1);
+    size_t        i            = 0;
+
+    for ( ; i + 2 <= n; i += 2 ) {
+        __m128i sum = _mm_add_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(r + i)),
+                                    _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)));
+
+        __m128i carry_out = _mm_cmpgt_epi64(sum, base_minus_1);
+        sum               = _mm_sub_epi64(sum, _mm_and_si128(carry_out, base));
+
+        __m128i carry_in = _mm_unpacklo_epi64(_mm_set1_epi64x(0 - (PeInt)carry), carry_out);
+        sum              = _mm_sub_epi64(sum, carry_in);
+
+        if ( _mm_movemask_epi8(_mm_cmpeq_epi64(sum, base)) ) {
+            carry = AddLimbsScalar(r + i, a + i, 2, carry);
+        } else {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(r + i), sum);
+            carry = (_mm_movemask_pd(_mm_castsi128_pd(carry_out)) >> 1) & 1;
+        }
+    }
+
+    return AddLimbsScalar(r + i, a + i, n - i, carry);
+}
+
+PE_TARGET("sse4.2") PeUint SubtractLimbsSse42(PeUint* r, const PeUint* a, size_t n, PeUint borrow)
+{
+    const __m128i base     = _mm_set1_epi64x(kBase);
+    const __m128i all_ones = _mm_set1_epi64x(-1);
+    size_t        i        = 0;
+
+    for ( ; i + 2 <= n; i += 2 ) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r + i));
+        __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+
+        __m128i borrow_out = _mm_cmpgt_epi64(y, x);
+        __m128i diff       = _mm_add_epi64(_mm_sub_epi64(x, y), _mm_and_si128(borrow_out, base));
+
+        __m128i borrow_in = _mm_unpacklo_epi64(_mm_set1_epi64x(0 - (PeInt)borrow), borrow_out);
+        diff              = _mm_add_epi64(diff, borrow_in);
+
+        if ( _mm_movemask_epi8(_mm_cmpeq_epi64(diff, all_ones)) ) {
+            borrow = SubtractLimbsScalar(r + i, a + i, 2, borrow);
+        } else {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(r + i), diff);
+            borrow = (_mm_movemask_pd(_mm_castsi128_pd(borrow_out)) >> 1) & 1;
+        }
+    }
+
+    return SubtractLimbsScalar(r + i, a + i, n - i, borrow);
+}
+
+PE_TARGET("sse4.2") int CompareLimbsSse42(const PeUint* a, const PeUint* b, size_t n)
+{
+    size_t i = n;
+
+    for ( ; i >= 2; i -= 2 ) {
+        __m128i equal = _mm_cmpeq_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i - 2)),
+                                        _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i - 2)));
+
+        if ( _mm_movemask_pd(_mm_castsi128_pd(equal)) != 0x3 ) {
+            return CompareLimbsScalar(a + i - 2, b + i - 2, 2);
+        }
+    }
+
+    return CompareLimbsScalar(a, b, i);
+}
+#endif
+
+// The kernels chosen for this CPU
+struct LimbKernels
+{
+    AddLimbsKernel     add;
+    AddLimbsKernel     subtract;
+    CompareLimbsKernel compare;
+    const char*        name;
+};
+
+LimbKernels SelectLimbKernels()
+{
+#if defined(PE_LIMBS_X86)
+    bool has_avx2 = false, has_sse42 = false;
+
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    const int max_leaf = info[0];
+
+    __cpuid(info, 1);
+    has_sse42 = (info[2] & (1 << 20)) != 0;
+
+    // AVX2 also needs the OS to save the YMM registers (OSXSAVE and XCR0)
+    const bool os_avx = ((info[2] & (1 << 27)) != 0) && ((info[2] & (1 << 28)) != 0) && ((_xgetbv(0) & 0x6) == 0x6);
+    if ( os_avx && (max_leaf >= 7) ) {
+        __cpuidex(info, 7, 0);
+        has_avx2 = (info[1] & (1 << 5)) != 0;
+    }
+#else
+    __builtin_cpu_init();
+    has_avx2  = __builtin_cpu_supports("avx2");
+    has_sse42 = __builtin_cpu_supports("sse4.2");
+#endif
+
+    if ( has_avx2 ) {
+        return { AddLimbsAvx2, SubtractLimbsAvx2, CompareLimbsAvx2, "avx2" };
+    }
+    if ( has_sse42 ) {
+        return { AddLimbsSse42, SubtractLimbsSse42, CompareLimbsSse42, "sse4.2" };
+    }
+#endif
+
+    return { AddLimbsScalar, SubtractLimbsScalar, CompareLimbsScalar, "scalar" };
+}
+
+const LimbKernels& Kernels()
+{
+    static const LimbKernels kernels = SelectLimbKernels();
+    return kernels;
+}
+} // namespace
+
+const char* SimdKernelName()
+{
+    return Kernels().name;
+}
+
+// Add <a> (length na) to <r> (length nr) in place, where na <= nr.
+// Returns the carry out of the most significant limb of <r>.
+PeUint AddTo(PeUint* r, size_t nr, const PeUint* a, size_t na)
+{
+    PeUint carry = na < kSimdMinLimbs ? AddLimbsScalar(r, a, na, 0) : Kernels().add(r, a, na, 0);
+
+    // Propagate any remaining carry
+    for ( size_t i = na; carry && (i < nr); ++i ) {
+        ++r[i];
+        carry = r[i] == kBase;
+        if ( carry ) {
+            r[i] = 0;
+        }
+    }
+
+    return carry;
+}
+
+// Subtract <a> (length na) from <r> (length nr) in place, where na <= nr.
+// Returns the borrow out of the most significant limb of <r>.
+PeUint SubtractFrom(PeUint* r, size_t nr, const PeUint* a, size_t na)
+{
+    PeUint borrow = na < kSimdMinLimbs ? SubtractLimbsScalar(r, a, na, 0) : Kernels().subtract(r, a, na, 0);
+
+    // Propagate any remaining borrow
+    for ( size_t i = na; borrow && (i < nr); ++i ) {
+        borrow = r[i] == 0;
+        r[i]   = borrow ? (kBase - 1) : (r[i] - 1);
+    }
+
+    return borrow;
+}
+
+namespace
+{
+// Resolve deferred carries in <r> (length nr) so every limb is below kBase.
+// The caller guarantees the value fits within nr limbs.
+void NormaliseCarries(PeUint* r, size_t nr)
+{
+    PeUint carry = 0;
+
+    for ( size_t i = 0; i < nr; ++i ) {
+        PeUint cur = r[i] + carry;
+        r[i]       = cur % kBase;
+        carry      = cur / kBase; // Integer division
+    }
+}
+} // namespace
+
+// Schoolbook O(na * nb) multiplication.
+// Rather than dividing by kBase for every product, products are accumulated
+// into full 64 bit limbs and the carries are resolved every
+// kDeferredCarryRows rows. This keeps the inner loop a plain multiply-add.
+void MultiplySchoolbook(const PeUint* a, size_t na, const PeUint* b, size_t nb, PeUint* res)
+{
+    std::fill(res, res + na + nb, 0);
+
+    // Loop over the shorter operand in the outer loop
+    if ( na < nb ) {
+        std::swap(a, b);
+        std::swap(na, nb);
+    }
+
+    size_t pending_rows = 0;
+
+    for ( size_t i = 0; i < nb; ++i ) {
+        const PeUint bi = b[i];
+        if ( bi == 0 ) {
+            continue;
+        }
+
+        PeUint* row = res + i;
+        for ( size_t j = 0; j < na; ++j ) {
+            row[j] += a[j] * bi;
+        }
+
+        if ( ++pending_rows == kDeferredCarryRows ) {
+            NormaliseCarries(res, na + nb);
+            pending_rows = 0;
+        }
+    }
+
+    NormaliseCarries(res, na + nb);
+}
+
+// Schoolbook squaring. Each cross term a[i] * a[j] with i < j appears twice
+// in the square, so it's computed once and the sum of cross terms doubled,
+// adding the diagonal terms a[i]^2 in the same pass. This takes about half
+// the limb products of MultiplySchoolbook().
+void SquareSchoolbook(const PeUint* a, size_t na, PeUint* res)
+{
+    const size_t nres = 2 * na;
+    std::fill(res, res + nres, 0);
+
+    size_t pending_rows = 0;
+
+    for ( size_t i = 0; i < na; ++i ) {
+        const PeUint ai = a[i];
+        if ( ai == 0 ) {
+            continue;
+        }
+
+        PeUint* row = res + i;
+        for ( size_t j = i + 1; j < na; ++j ) {
+            row[j] += a[j] * ai;
+        }
+
+        if ( ++pending_rows == kDeferredCarryRows ) {
+            NormaliseCarries(res, nres);
+            pending_rows = 0;
+        }
+    }
+
+    NormaliseCarries(res, nres);
+
+    // Double and add the diagonal. Each step is below 2 * kBase + kBase^2
+    // plus the carry, which fits in 64 bits.
+    PeUint carry = 0;
+
+    for ( size_t k = 0; k < nres; ++k ) {
+        PeUint cur = 2 * res[k] + carry;
+        if ( (k & 1) == 0 ) {
+            cur += a[k / 2] * a[k / 2];
+        }
+
+        res[k] = cur % kBase;
+        carry  = cur / kBase;
+    }
+}
+
+namespace
+{
+// Parallel multiplication settings. A thread count of 0 means the hardware
+// concurrency.
+std::atomic<size_t> multiply_threads(0);
+std::atomic<size_t> parallel_multiply_threshold(kParallelMultiplyThreshold);
+} // namespace
+
+void SetMultiplyThreads(size_t threads)
+{
+    multiply_threads = threads;
+}
+
+size_t MultiplyThreads()
+{
+    size_t threads = multiply_threads;
+    if ( threads == 0 ) {
+        threads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    }
+
+    return threads;
+}
+
+void SetParallelMultiplyThreshold(size_t limbs)
+{
+    parallel_multiply_threshold = limbs;
+}
+
+size_t ParallelMultiplyThreshold()
+{
+    return parallel_multiply_threshold;
+}
+
+namespace
+{
+// The number of threads the multiplication running on this thread may use.
+// Zero means this thread isn't running part of a parallel multiplication,
+// so the full MultiplyThreads() is available.
+thread_local size_t tl_thread_budget = 0;
+
+size_t ThreadBudget()
+{
+    return tl_thread_budget ? tl_thread_budget : MultiplyThreads();
+}
+
+// Test whether a product with shorter operand <nb> limbs should be split
+bool UseParallel(size_t nb)
+{
+    return (nb >= ParallelMultiplyThreshold()) && (ThreadBudget() > 1);
+}
+
+// Sets this thread's budget for the lifetime of the object
+class ThreadBudgetScope
+{
+public:
+    explicit ThreadBudgetScope(size_t budget) : previous_(tl_thread_budget)
+    {
+        tl_thread_budget = budget;
+    }
+
+    ~ThreadBudgetScope()
+    {
+        tl_thread_budget = previous_;
+    }
+
+private:
+    size_t previous_;
+};
+
+// Run task(0) to task(n_tasks - 1), returning once all have finished.
+// If <parallel> is true they run on up to ThreadBudget() threads, including
+// this one: the tasks are dealt out in turn to the threads, and each thread
+// gets an equal share of the budget for any parallel work of its own.
+// Exceptions (e.g. bad_alloc) are passed on once every thread has finished.
+void RunParallel(size_t n_tasks, bool parallel, const std::function<void(size_t)>& task)
+{
+    if ( !parallel ) {
+        for ( size_t i = 0; i < n_tasks; ++i ) {
+            task(i);
+        }
+        return;
+    }
+
+    const size_t budget  = ThreadBudget();
+    const size_t workers = std::min(budget, n_tasks);
+
+    auto run_share = [&](size_t worker) {
+        ThreadBudgetScope scope(budget / workers + (worker < budget % workers ? 1 : 0));
+        for ( size_t i = worker; i < n_tasks; i += workers ) {
+            task(i);
+        }
+    };
+
+    if ( workers <= 1 ) {
+        run_share(0);
+        return;
+    }
+
+    std::vector<std::future<void>> others;
+    for ( size_t worker = 1; worker < workers; ++worker ) {
+        others.push_back(std::async(std::launch::async, run_share, worker));
+    }
+
+    std::exception_ptr error;
+    try {
+        run_share(0);
+    } catch ( ... ) {
+        error = std::current_exception();
+    }
+
+    for ( auto& other: others ) {
+        try {
+            other.get();
+        } catch ( ... ) {
+            if ( !error ) {
+                error = std::current_exception();
+            }
+        }
+    }
+
+    if ( error ) {
+        std::rethrow_exception(error);
+    }
+}
+
+// Run body(begin, end) over [0, n) split into one contiguous range per
+// thread of the budget, or in one piece if <parallel> is false
+void ParallelFor(size_t n, bool parallel, const std::function<void(size_t, size_t)>& body)
+{
+    const size_t parts = parallel ? std::min(ThreadBudget(), std::max<size_t>(n, 1)) : 1;
+
+    RunParallel(parts, parallel, [&](size_t part) {
+        body(n * part / parts, n * (part + 1) / parts);
+    });
+}
+
+// Helper for Toom-3 and Karatsuba: the length of a limb array once any
+// leading (most significant) zero limbs are ignored.
+size_t TrimmedLength(const PeUint* a, size_t na)
+{
+    while ( (na > 0) && (a[na - 1] == 0) ) {
+        --na;
+    }
+
+    return na;
+}
+
+// Helper to multiply two limb arrays that may contain leading zeros or be
+// empty, accumulating the product into <r> (length nr).
+// Returns any carry out of <r>, which callers treat as an error in logic.
+PeUint MultiplyAddTo(PeUint* r, size_t nr, const PeUint* a, size_t na, const PeUint* b, size_t nb)
+{
+    na = TrimmedLength(a, na);
+    nb = TrimmedLength(b, nb);
+
+    if ( (na == 0) || (nb == 0) ) {
+        return 0;
+    }
+
+    ScratchLimbs prod(na + nb);
+    Multiply(a, na, b, nb, prod.data());
+
+    return AddTo(r, nr, prod.data(), TrimmedLength(prod.data(), prod.size()));
+}
+} // namespace
+
+// Karatsuba multiplication, for nb <= na < 2 * nb.
+// Splitting each number at k limbs as a = a1 * B^k + a0, b = b1 * B^k + b0:
+//    a * b = z2 * B^2k + (z1 - z2 - z0) * B^k + z0
+// where z0 = a0 * b0, z2 = a1 * b1 and z1 = (a0 + a1) * (b0 + b1).
+void MultiplyKaratsuba(const PeUint* a, size_t na, const PeUint* b, size_t nb, PeUint* res)
+{
+    // Split point: both high halves are non-empty since na < 2 * nb
+    const size_t k  = na / 2;
+    const size_t a1 = na - k;
+    const size_t b1 = nb - k;
+
+    // When squaring, every product below is a square too, and Multiply()
+    // passes those on to the squaring code
+    const bool is_square = (a == b) && (na == nb);
+
+    // Sums of the halves, each one limb longer to hold any carry
+    ScratchLimbs sum_a(a1 + 1, 0), sum_b(is_square ? 0 : std::max(k, b1) + 1, 0);
+
+    std::copy(a + k, a + na, sum_a.begin());
+    sum_a[a1] = AddTo(sum_a.data(), a1, a, k);
+
+    if ( is_square ) {
+        // a0 + a1 is used for both operands
+    } else if ( b1 >= k ) {
+        std::copy(b + k, b + nb, sum_b.begin());
+        sum_b[b1] = AddTo(sum_b.data(), b1, b, k);
+    } else {
+        std::copy(b, b + k, sum_b.begin());
+        sum_b[k] = AddTo(sum_b.data(), k, b + k, b1);
+    }
+
+    const PeUint* sum_b_data = is_square ? sum_a.data() : sum_b.data();
+    const size_t  n_sum_a    = TrimmedLength(sum_a.data(), sum_a.size());
+    const size_t  n_sum_b    = is_square ? n_sum_a : TrimmedLength(sum_b.data(), sum_b.size());
+    ScratchLimbs  z1(n_sum_a + n_sum_b);
+
+    // z0 and z2 go straight into the low and high parts of the result.
+    // The three products are independent, so large ones run in parallel.
+    auto product = [&](size_t i) {
+        if ( i == 0 ) {
+            Multiply(a, k, b, k, res);
+        } else if ( i == 1 ) {
+            Multiply(a + k, a1, b + k, b1, res + 2 * k);
+        } else {
+            Multiply(sum_a.data(), n_sum_a, sum_b_data, n_sum_b, z1.data());
+        }
+    };
+
+    RunParallel(3, UseParallel(nb), product);
+
+    // z1 - z0 - z2 = a0 * b1 + a1 * b0, which can't be negative
+    SubtractFrom(z1.data(), z1.size(), res, TrimmedLength(res, 2 * k));
+    SubtractFrom(z1.data(), z1.size(), res + 2 * k, TrimmedLength(res + 2 * k, a1 + b1));
+
+    // Add the middle term into place. The middle term is less than
+    // B^(na + nb - k) so any limbs above that are zero.
+    AddTo(res + k, na + nb - k, z1.data(), TrimmedLength(z1.data(), z1.size()));
+}
+
+// Toom-3 helpers working on signed limb arrays
+
+namespace
+{
+// Construct a signed value from a (possibly empty or zero padded) limb array
+SignedLimbs ToSigned(const PeUint* a, size_t na)
+{
+    SignedLimbs x;
+    x.mag.assign(a, a + TrimmedLength(a, na));
+
+    return x;
+}
+} // namespace
+
+// Compare <a> with <b>, ignoring leading zero limbs
+int Compare(const PeUint* a, size_t na, const PeUint* b, size_t nb)
+{
+    na = TrimmedLength(a, na);
+    nb = TrimmedLength(b, nb);
+
+    if ( na != nb ) {
+        return na < nb ? -1 : 1;
+    }
+
+    return na < kSimdMinLimbs ? CompareLimbsScalar(a, b, na) : Kernels().compare(a, b, na);
+}
+
+// The arrays are lined up at their most significant limbs. If they agree
+// over their common length, the one with more limbs below that length wins
+// unless those limbs are all zero.
+int CompareOffset(const PeUint* a, size_t na, size_t oa, const PeUint* b, size_t nb, size_t ob)
+{
+    if ( oa == ob ) {
+        return Compare(a, na, b, nb);
+    }
+
+    na = TrimmedLength(a, na);
+    nb = TrimmedLength(b, nb);
+
+    // Zero has no limbs, whatever its offset
+    if ( (na == 0) || (nb == 0) ) {
+        return (na != 0) - (nb != 0);
+    }
+
+    if ( na + oa != nb + ob ) {
+        return na + oa < nb + ob ? -1 : 1;
+    }
+
+    const size_t top = std::max(oa, ob);
+    const int    cmp = Compare(a + (top - oa), na + oa - top, b + (top - ob), nb + ob - top);
+    if ( cmp != 0 ) {
+        return cmp;
+    }
+
+    if ( oa < ob ) {
+        return TrimmedLength(a, ob - oa) > 0 ? 1 : 0;
+    }
+    return TrimmedLength(b, oa - ob) > 0 ? -1 : 0;
+}
+
+namespace
+{
+// Compare magnitudes, returning -1, 0 or 1
+int CompareMagnitude(const std::vector<PeUint>& a, const std::vector<PeUint>& b)
+{
+    return Compare(a.data(), a.size(), b.data(), b.size());
+}
+
+// x + y for signed limb arrays
+SignedLimbs SignedAdd(const SignedLimbs& x, const SignedLimbs& y)
+{
+    SignedLimbs res;
+
+    if ( x.negative == y.negative ) {
+        // Same signs: add magnitudes
+        const std::vector<PeUint>& longer  = x.mag.size() >= y.mag.size() ? x.mag : y.mag;
+        const std::vector<PeUint>& shorter = x.mag.size() >= y.mag.size() ? y.mag : x.mag;
+
+        res.mag = longer;
+        res.mag.push_back(0);
+        AddTo(res.mag.data(), res.mag.size(), shorter.data(), shorter.size());
+        res.negative = x.negative;
+    } else {
+        // Different signs: subtract the smaller magnitude from the larger
+        int cmp = CompareMagnitude(x.mag, y.mag);
+
+        if ( cmp == 0 ) {
+            return res;
+        }
+
+        const SignedLimbs& larger  = cmp > 0 ? x : y;
+        const SignedLimbs& smaller = cmp > 0 ? y : x;
+
+        res.mag = larger.mag;
+        SubtractFrom(res.mag.data(), res.mag.size(), smaller.mag.data(), smaller.mag.size());
+        res.negative = larger.negative;
+    }
+
+    res.mag.resize(TrimmedLength(res.mag.data(), res.mag.size()));
+
+    return res;
+}
+
+// x - y for signed limb arrays
+SignedLimbs SignedSubtract(const SignedLimbs& x, SignedLimbs y)
+{
+    if ( !y.mag.empty() ) {
+        y.negative = !y.negative;
+    }
+
+    return SignedAdd(x, y);
+}
+
+// x * m for a small positive multiplier m
+SignedLimbs SignedMultiplySmall(SignedLimbs x, PeUint m)
+{
+    PeUint carry = 0;
+
+    for ( auto& xi: x.mag ) {
+        PeUint cur = xi * m + carry;
+        xi         = cur % kBase;
+        carry      = cur / kBase;
+    }
+
+    if ( carry ) {
+        x.mag.push_back(carry);
+    }
+
+    return x;
+}
+
+// x / d for a small positive divisor d that is known to divide x exactly
+SignedLimbs SignedDivideExactSmall(SignedLimbs x, PeUint d)
+{
+    PeUint rem = 0;
+
+    for ( size_t i = x.mag.size(); i-- > 0; ) {
+        PeUint cur = x.mag[i] + rem * kBase;
+        x.mag[i]   = cur / d;
+        rem        = cur % d;
+    }
+
+    x.mag.resize(TrimmedLength(x.mag.data(), x.mag.size()));
+    if ( x.mag.empty() ) {
+        x.negative = false;
+    }
+
+    return x;
+}
+
+// x * y for signed limb arrays
+SignedLimbs SignedMultiply(const SignedLimbs& x, const SignedLimbs& y)
+{
+    SignedLimbs res;
+
+    if ( x.mag.empty() || y.mag.empty() ) {
+        return res;
+    }
+
+    res.mag.resize(x.mag.size() + y.mag.size());
+    Multiply(x.mag.data(), x.mag.size(), y.mag.data(), y.mag.size(), res.mag.data());
+    res.mag.resize(TrimmedLength(res.mag.data(), res.mag.size()));
+    res.negative = x.negative != y.negative;
+
+    return res;
+}
+} // namespace
+
+// Toom-3 multiplication, for nb <= na and nb > 2 * ceil(na / 3).
+// Each number is split into three k limb pieces and treated as a polynomial
+// in B^k, e.g. a(x) = a2 * x^2 + a1 * x + a0. The product polynomial is
+// evaluated at the points 0, 1, -1, -2 and infinity using five recursive
+// multiplications then interpolated, following the sequence given in:
+//   Bodrato, Marco (2007). "Towards Optimal Toom-Cook Multiplication for
+//   Univariate and Multivariate Polynomials in Characteristic 2 and 0".
+void MultiplyToom3(const PeUint* a, size_t na, const PeUint* b, size_t nb, PeUint* res)
+{
+    const size_t k = (na + 2) / 3;
+
+    // When squaring, b's pieces and evaluations are the same as a's, and
+    // the pointwise products are squares
+    const bool is_square = (a == b) && (na == nb);
+
+    // Split into pieces, clamping to the operand lengths
+    SignedLimbs a0 = ToSigned(a, k);
+    SignedLimbs a1 = ToSigned(a + k, k);
+    SignedLimbs a2 = ToSigned(a + 2 * k, na - 2 * k);
+
+    // Evaluation at 1, -1 and -2 (0 and infinity are just a0 and a2)
+    SignedLimbs pa   = SignedAdd(a0, a2);
+    SignedLimbs pa1  = SignedAdd(pa, a1);
+    SignedLimbs pam1 = SignedSubtract(pa, a1);
+    SignedLimbs pam2 = SignedSubtract(SignedMultiplySmall(SignedAdd(pam1, a2), 2), a0);
+
+    SignedLimbs b0, b2, pb1, pbm1, pbm2;
+
+    if ( !is_square ) {
+        b0             = ToSigned(b, k);
+        b2             = ToSigned(b + 2 * k, nb - 2 * k);
+        SignedLimbs b1 = ToSigned(b + k, k);
+
+        SignedLimbs pb = SignedAdd(b0, b2);
+        pb1            = SignedAdd(pb, b1);
+        pbm1           = SignedSubtract(pb, b1);
+        pbm2           = SignedSubtract(SignedMultiplySmall(SignedAdd(pbm1, b2), 2), b0);
+    }
+
+    // Pointwise products, which are independent so large ones run in parallel
+    SignedLimbs        r0, r1, rm1, rm2, rinf;
+    SignedLimbs*       products[5] = { &r0, &r1, &rm1, &rm2, &rinf };
+    const SignedLimbs* lhs[5]      = { &a0, &pa1, &pam1, &pam2, &a2 };
+    const SignedLimbs* rhs[5]      = { &b0, &pb1, &pbm1, &pbm2, &b2 };
+
+    auto product = [&](size_t i) {
+        *products[i] = SignedMultiply(*lhs[i], is_square ? *lhs[i] : *rhs[i]);
+    };
+
+    RunParallel(5, UseParallel(nb), product);
+
+    // Interpolation
+    SignedLimbs c3 = SignedDivideExactSmall(SignedSubtract(rm2, r1), 3);
+    SignedLimbs c1 = SignedDivideExactSmall(SignedSubtract(r1, rm1), 2);
+    SignedLimbs c2 = SignedSubtract(rm1, r0);
+    c3             = SignedAdd(SignedDivideExactSmall(SignedSubtract(c2, c3), 2), SignedMultiplySmall(rinf, 2));
+    c2             = SignedSubtract(SignedAdd(c2, c1), rinf);
+    c1             = SignedSubtract(c1, c3);
+
+    // Recomposition: every coefficient is non-negative at this point since
+    // they are the coefficients of a product of non-negative polynomials
+    const size_t       nres = na + nb;
+    const SignedLimbs* coefficients[5] = { &r0, &c1, &c2, &c3, &rinf };
+
+    std::fill(res, res + nres, 0);
+    for ( size_t i = 0; i < 5; ++i ) {
+        const std::vector<PeUint>& c = coefficients[i]->mag;
+        if ( !c.empty() ) {
+            AddTo(res + i * k, nres - i * k, c.data(), c.size());
+        }
+    }
+}
+
+// Number theoretic transform (NTT) helpers.
+// Three NTT friendly primes of the form c * 2^k + 1 are used. Each one gives
+// an exact cyclic convolution modulo that prime; the true convolution is then
+// recovered with the Chinese Remainder Theorem. The product of the primes is
+// about 5.9 * 10^25, while a convolution coefficient is at most
+// kNttMaxLength * (kBase - 1)^2, about 1.7 * 10^23, so the recovery is exact.
+// The transform length is limited to 2^24 by the third prime.
+const PeUint kNttPrime1 = 469762049; // 7 * 2^26 + 1, primitive root 3
+const PeUint kNttPrime2 = 167772161; // 5 * 2^25 + 1, primitive root 3
+const PeUint kNttPrime3 = 754974721; // 45 * 2^24 + 1, primitive root 11
+
+// (b ^ e) mod P by binary exponentiation. All values are below 2^30
+// so the products fit comfortably in 64 bits.
+template<PeUint P> PeUint NttPowMod(PeUint b, PeUint e)
+{
+    PeUint res = 1;
+    b %= P;
+
+    while ( e > 0 ) {
+        if ( e & 1 ) {
+            res = res * b % P;
+        }
+        b = b * b % P;
+        e >>= 1;
+    }
+
+    return res;
+}
+
+// One butterfly pass of length <len> over a[0, n), for positions [j_begin,
+// j_end) of each block of <len> elements. roots[j] is the j-th power of the
+// pass's root of unity.
+template<PeUint P>
+void NttPass(std::uint32_t* a, size_t n, size_t len, const std::uint32_t* roots, size_t j_begin, size_t j_end)
+{
+    const size_t half = len / 2;
+
+    for ( size_t i = 0; i < n; i += len ) {
+        std::uint32_t* lo = a + i;
+        std::uint32_t* hi = a + i + half;
+
+        for ( size_t j = j_begin; j < j_end; ++j ) {
+            PeUint u = lo[j];
+            PeUint v = hi[j] * (PeUint)roots[j] % P;
+
+            lo[j] = (std::uint32_t)(u + v < P ? u + v : u + v - P);
+            hi[j] = (std::uint32_t)(u >= v ? u - v : u + P - v);
+        }
+    }
+}
+
+// In place iterative radix 2 NTT of <a> modulo P using primitive root G.
+// The length of <a> must be a power of two dividing P - 1.
+// The inverse transform includes the 1/n scaling.
+// If <parallel> is true the work is split across this thread's budget.
+template<PeUint P, PeUint G> void NttTransform(std::vector<std::uint32_t>& a, bool inverse, bool parallel)
+{
+    const size_t n = a.size();
+
+    // Bit reversal permutation
+    for ( size_t i = 1, j = 0; i < n; ++i ) {
+        size_t bit = n >> 1;
+        for ( ; j & bit; bit >>= 1 ) {
+            j ^= bit;
+        }
+        j ^= bit;
+
+        if ( i < j ) {
+            std::swap(a[i], a[j]);
+        }
+    }
+
+    // Roots of unity for every pass: roots[half + j] is the j-th power of
+    // the root for the pass of length 2 * half. The longest pass uses powers
+    // of an n-th root of unity, and each shorter pass every other root of
+    // the pass above.
+    std::vector<std::uint32_t> roots(std::max<size_t>(n, 2));
+    const size_t               top = n / 2;
+
+    PeUint w = NttPowMod<P>(G, (P - 1) / std::max<size_t>(n, 2));
+    if ( inverse ) {
+        w = NttPowMod<P>(w, P - 2);
+    }
+
+    ParallelFor(top, parallel, [&](size_t begin, size_t end) {
+        PeUint x = NttPowMod<P>(w, begin);
+        for ( size_t j = begin; j < end; ++j ) {
+            roots[top + j] = (std::uint32_t)x;
+            x              = x * w % P;
+        }
+    });
+
+    for ( size_t half = top / 2; half > 0; half /= 2 ) {
+        for ( size_t j = 0; j < half; ++j ) {
+            roots[half + j] = roots[2 * (half + j)];
+        }
+    }
+
+    // Passes up to length <block> stay within independent blocks of that
+    // many elements, so threads take whole blocks through all those passes.
+    // The longer passes are split between threads by butterfly position.
+    size_t block = n;
+    if ( parallel ) {
+        while ( (block > 2) && (n / block < 4 * ThreadBudget()) ) {
+            block /= 2;
+        }
+    }
+
+    RunParallel(n / std::max<size_t>(block, 1), parallel, [&](size_t i) {
+        for ( size_t len = 2; len <= block; len <<= 1 ) {
+            NttPass<P>(&a[i * block], block, len, &roots[len / 2], 0, len / 2);
+        }
+    });
+
+    for ( size_t len = 2 * block; len <= n; len <<= 1 ) {
+        ParallelFor(len / 2, parallel, [&](size_t begin, size_t end) {
+            NttPass<P>(a.data(), n, len, &roots[len / 2], begin, end);
+        });
+    }
+
+    // Scale by 1/n for the inverse
+    if ( inverse ) {
+        PeUint n_inv = NttPowMod<P>(n, P - 2);
+        ParallelFor(n, parallel, [&](size_t begin, size_t end) {
+            for ( size_t i = begin; i < end; ++i ) {
+                a[i] = (std::uint32_t)(a[i] * n_inv % P);
+            }
+        });
+    }
+}
+
+// Cyclic convolution of <a> and <b> modulo P with transform length n,
+// returned as a vector of n residues. If <b> is null, <a> is squared
+// which saves one forward transform.
+template<PeUint P, PeUint G>
+std::vector<std::uint32_t> NttConvolve(const PeUint* a, size_t na, const PeUint* b, size_t nb, size_t n, bool parallel)
+{
+    std::vector<std::uint32_t> fa(n, 0), fb;
+
+    // Forward transforms, which are independent of each other
+    RunParallel(b ? 2 : 1, parallel, [&](size_t i) {
+        const PeUint*               x  = i == 0 ? a : b;
+        const size_t                nx = i == 0 ? na : nb;
+        std::vector<std::uint32_t>& fx = i == 0 ? fa : fb;
+
+        fx.resize(n, 0);
+        for ( size_t k = 0; k < nx; ++k ) {
+            fx[k] = (std::uint32_t)(x[k] % P);
+        }
+        NttTransform<P, G>(fx, false, parallel);
+    });
+
+    const std::vector<std::uint32_t>& fy = b ? fb : fa;
+    ParallelFor(n, parallel, [&](size_t begin, size_t end) {
+        for ( size_t i = begin; i < end; ++i ) {
+            fa[i] = (std::uint32_t)((PeUint)fa[i] * fy[i] % P);
+        }
+    });
+
+    NttTransform<P, G>(fa, true, parallel);
+
+    return fa;
+}
+
+// NTT multiplication: three modular convolutions are combined using Garner's
+// form of the Chinese Remainder Theorem, then carries are propagated in base
+// kBase. Squaring (a == b) is detected and uses fewer transforms. Large
+// products run the three convolutions, and the work within each, in parallel.
+void MultiplyNtt(const PeUint* a, size_t na, const PeUint* b, size_t nb, PeUint* res)
+{
+    const size_t nres     = na + nb;
+    const size_t conv_len = nres - 1;
+
+    // Transform length is the next power of two holding the convolution
+    size_t n = 1;
+    while ( n < conv_len ) {
+        n <<= 1;
+    }
+
+    const bool    is_square = (a == b) && (na == nb);
+    const PeUint* b_in      = is_square ? nullptr : b;
+    const bool    parallel  = UseParallel(std::min(na, nb));
+
+    std::vector<std::uint32_t> r1, r2, r3;
+
+    RunParallel(3, parallel, [&](size_t i) {
+        if ( i == 0 ) {
+            r1 = NttConvolve<kNttPrime1, 3>(a, na, b_in, nb, n, parallel);
+        } else if ( i == 1 ) {
+            r2 = NttConvolve<kNttPrime2, 3>(a, na, b_in, nb, n, parallel);
+        } else {
+            r3 = NttConvolve<kNttPrime3, 11>(a, na, b_in, nb, n, parallel);
+        }
+    });
+
+    // Garner constants
+    const PeUint p12     = kNttPrime1 * kNttPrime2; // Fits in 64 bits
+    const PeUint inv_p1  = NttPowMod<kNttPrime2>(kNttPrime1, kNttPrime2 - 2);
+    const PeUint inv_p12 = NttPowMod<kNttPrime3>(p12 % kNttPrime3, kNttPrime3 - 2);
+    const PeUint p12_hi  = p12 / kBase; // p12 split around kBase so that
+    const PeUint p12_lo  = p12 % kBase; // p12 * t2 can be carried in pieces
+
+    // Recover each coefficient x = x12 + p12 * t2. x is written as
+    // low + high * kBase, where both parts fit in 64 bits: low goes in res
+    // and t2 (which gives high) replaces the third residue. This is
+    // independent for each coefficient, so can be split between threads.
+    ParallelFor(nres, parallel, [&](size_t begin, size_t end) {
+        for ( size_t k = begin; k < end; ++k ) {
+            if ( k < conv_len ) {
+                PeUint x1  = r1[k];
+                PeUint t1  = (r2[k] + kNttPrime2 - x1 % kNttPrime2) % kNttPrime2 * inv_p1 % kNttPrime2;
+                PeUint x12 = x1 + kNttPrime1 * t1;
+                PeUint t2  = (r3[k] + kNttPrime3 - x12 % kNttPrime3) % kNttPrime3 * inv_p12 % kNttPrime3;
+
+                res[k] = x12 + p12_lo * t2;
+                r3[k]  = (std::uint32_t)t2;
+            } else {
+                res[k] = 0;
+            }
+        }
+    });
+
+    // Propagate carries, folding each high part straight into the next carry
+    PeUint carry = 0;
+
+    for ( size_t k = 0; k < nres; ++k ) {
+        PeUint cur  = res[k] + carry;
+        PeUint high = k < conv_len ? p12_hi * r3[k] : 0;
+
+        res[k] = cur % kBase;
+        carry  = cur / kBase + high;
+    }
+}
+
+// Multiply <a> (length na) by <b> (length nb), writing exactly na + nb limbs
+// to <res>, choosing an algorithm based on operand sizes.
+void Multiply(const PeUint* a, size_t na, const PeUint* b, size_t nb, PeUint* res)
+{
+    // Work with a as the longer operand
+    if ( na < nb ) {
+        std::swap(a, b);
+        std::swap(na, nb);
+    }
+
+    // Squares (with the same array for both operands) take the squaring
+    // paths: the schoolbook square below the threshold, and above it the
+    // algorithms below each detect a square and pass squares down in turn
+    const bool is_square = (a == b) && (na == nb);
+
+    // Small operands: schoolbook is fastest
+    if ( nb < kKaratsubaThreshold ) {
+        if ( is_square ) {
+            SquareSchoolbook(a, na, res);
+        } else {
+            MultiplySchoolbook(a, na, b, nb, res);
+        }
+        return;
+    }
+
+    // Large operands: NTT if the product fits in a single transform
+    if ( (nb >= kNttThreshold) && (na + nb <= kNttMaxLength) ) {
+        MultiplyNtt(a, na, b, nb, res);
+        return;
+    }
+
+    // Very unbalanced operands: split the longer operand into chunks of nb
+    // limbs and accumulate the balanced products of each chunk
+    if ( na >= 2 * nb ) {
+        std::fill(res, res + na + nb, 0);
+
+        for ( size_t offset = 0; offset < na; offset += nb ) {
+            size_t chunk = std::min(nb, na - offset);
+            MultiplyAddTo(res + offset, na + nb - offset, a + offset, chunk, b, nb);
+        }
+
+        return;
+    }
+
+    // Balanced operands: Toom-3 if large enough and b has three pieces
+    if ( (nb >= kToom3Threshold) && (nb > 2 * ((na + 2) / 3)) ) {
+        MultiplyToom3(a, na, b, nb, res);
+    } else {
+        MultiplyKaratsuba(a, na, b, nb, res);
+    }
+}
+
+void Square(const PeUint* a, size_t na, PeUint* res)
+{
+    Multiply(a, na, a, na, res);
+}
+
+// Divide <u> (length nu) in place by a single limb divisor, returning the
+// remainder
+PeUint DivideSmall(PeUint* u, size_t nu, PeUint d)
+{
+    PeUint rem = 0;
+
+    for ( size_t i = nu; i-- > 0; ) {
+        PeUint cur = u[i] + rem * kBase;
+        u[i]       = cur / d;
+        rem        = cur % d;
+    }
+
+    return rem;
+}
+
+// Multiply <a> (length na) by a single limb multiplier, writing na + 1 limbs
+// to <res>. The result may overlap <a> exactly.
+void MultiplySmall(const PeUint* a, size_t na, PeUint m, PeUint* res)
+{
+    PeUint carry = 0;
+
+    for ( size_t i = 0; i < na; ++i ) {
+        PeUint cur = a[i] * m + carry;
+        res[i]     = cur % kBase;
+        carry      = cur / kBase;
+    }
+
+    res[na] = carry;
+}
+
+// Add m * <a> (length na) to <r> (length nr) in one pass, where na < nr.
+// Each step is below kBase^2 so its carry stays below kBase.
+PeUint MultiplySmallAddTo(PeUint* r, size_t nr, const PeUint* a, size_t na, PeUint m)
+{
+    PeUint carry = 0;
+
+    for ( size_t i = 0; i < na; ++i ) {
+        PeUint cur = r[i] + a[i] * m + carry;
+        r[i]       = cur % kBase;
+        carry      = cur / kBase;
+    }
+
+    for ( size_t i = na; carry && (i < nr); ++i ) {
+        PeUint cur = r[i] + carry;
+        r[i]       = cur % kBase;
+        carry      = cur / kBase;
+    }
+
+    return carry;
+}
+
+// Subtract m * <a> (length na) from <r> (length nr) in one pass, where
+// na < nr. The borrow out of each step is the product's high part plus one
+// if the low part didn't fit.
+PeUint MultiplySmallSubtractFrom(PeUint* r, size_t nr, const PeUint* a, size_t na, PeUint m)
+{
+    PeUint borrow = 0;
+
+    for ( size_t i = 0; i < na; ++i ) {
+        PeUint cur = a[i] * m + borrow;
+        PeUint low = cur % kBase;
+
+        borrow = cur / kBase;
+        if ( r[i] >= low ) {
+            r[i] -= low;
+        } else {
+            r[i] += kBase - low;
+            ++borrow;
+        }
+    }
+
+    for ( size_t i = na; borrow && (i < nr); ++i ) {
+        PeUint low = borrow % kBase;
+
+        borrow /= kBase;
+        if ( r[i] >= low ) {
+            r[i] -= low;
+        } else {
+            r[i] += kBase - low;
+            ++borrow;
+        }
+    }
+
+    return borrow ? 1 : 0;
+}
+
+// Replace <r> (length nr) with kBase^nr - r
+void Negate(PeUint* r, size_t nr)
+{
+    // Limbs below the lowest non-zero one stay zero
+    size_t i = 0;
+    while ( (i < nr) && (r[i] == 0) ) {
+        ++i;
+    }
+
+    if ( i < nr ) {
+        r[i] = kBase - r[i];
+        for ( ++i; i < nr; ++i ) {
+            r[i] = kBase - 1 - r[i];
+        }
+    }
+}
+
+// Knuth's Algorithm D (The Art of Computer Programming, Vol. 2, 4.3.1).
+// Both numbers are first scaled so that the leading divisor limb is at least
+// kBase / 2, which guarantees each trial quotient limb estimated from the
+// leading limbs is at most two too large. The estimate is then refined with
+// the second divisor limb, so a final add back step is very rarely needed.
+void DivideKnuth(const PeUint* u, size_t nu, const PeUint* v, size_t nv, PeUint* q, PeUint* r)
+{
+    // Single limb divisors only need short division
+    if ( nv == 1 ) {
+        PeUint rem = 0;
+
+        if ( q ) {
+            std::copy(u, u + nu, q);
+            rem = DivideSmall(q, nu, v[0]);
+        } else {
+            for ( size_t i = nu; i-- > 0; ) {
+                rem = (rem * kBase + u[i]) % v[0];
+            }
+        }
+
+        if ( r ) {
+            r[0] = rem;
+        }
+
+        return;
+    }
+
+    // Normalise, the numerator gains an extra limb.
+    // Small divisions keep the normalised copies on the stack.
+    const PeUint d = kBase / (v[nv - 1] + 1);
+    ScratchLimbs un(nu + 1), vn(nv + 1);
+    MultiplySmall(u, nu, d, un.data());
+    MultiplySmall(v, nv, d, vn.data()); // vn[nv] is always zero
+
+    const PeUint v_top  = vn[nv - 1];
+    const PeUint v_next = vn[nv - 2];
+
+    // Loop over quotient limbs from most to least significant
+    for ( size_t j = nu - nv + 1; j-- > 0; ) {
+        // Estimate the quotient limb from the leading limbs
+        PeUint num   = un[j + nv] * kBase + un[j + nv - 1];
+        PeUint q_hat = num / v_top;
+        PeUint r_hat = num % v_top;
+
+        while ( (q_hat >= kBase) || (q_hat * v_next > r_hat * kBase + un[j + nv - 2]) ) {
+            --q_hat;
+            r_hat += v_top;
+            if ( r_hat >= kBase ) {
+                break;
+            }
+        }
+
+        // Multiply and subtract q_hat * vn from the current window of un
+        PeUint borrow = 0, carry = 0;
+        for ( size_t i = 0; i <= nv; ++i ) {
+            PeUint prod = q_hat * vn[i] + carry;
+            carry       = prod / kBase;
+
+            PeUint sub = prod % kBase + borrow;
+            borrow     = un[i + j] < sub;
+            un[i + j]  = borrow ? (un[i + j] + kBase - sub) : (un[i + j] - sub);
+        }
+
+        // The estimate was one too large: add back a copy of the divisor.
+        // The carry out of the top limb cancels the borrow, so is ignored.
+        if ( borrow ) {
+            --q_hat;
+            AddTo(&un[j], nv + 1, vn.data(), nv);
+        }
+
+        if ( q ) {
+            q[j] = q_hat;
+        }
+    }
+
+    // Unnormalise the remainder
+    if ( r ) {
+        DivideSmall(un.data(), nv, d);
+        std::copy(un.begin(), un.begin() + nv, r);
+    }
+}
+
+namespace
+{
+// Reciprocal of a normalised <v> (length n, leading limb >= kBase / 2):
+// writes floor((B^2n - 1) / v), which has n + 1 limbs, to <inv>.
+// The reciprocal of the leading half of v is found recursively and then
+// refined with one Newton step
+//    x' = x + x * (B^2n - v * x) / B^2n
+// which doubles the number of correct limbs. A final multiply and check
+// removes the few units of error left by truncation.
+void Reciprocal(const PeUint* v, size_t n, PeUint* inv)
+{
+    // Base case: direct division
+    if ( n <= kKaratsubaThreshold ) {
+        ScratchLimbs num(2 * n, kBase - 1);
+        DivideKnuth(num.data(), 2 * n, v, n, inv, nullptr);
+        return;
+    }
+
+    // Initial approximation from the leading half of v, scaled to n limbs
+    const size_t h = (n + 1) / 2;
+    ScratchLimbs x(n + 1, 0);
+    Reciprocal(v + n - h, h, &x[n - h]);
+
+    // Error term e = B^2n - v * x, which is small and may be negative
+    ScratchLimbs vx(2 * n + 1), e(2 * n + 1, 0);
+    Multiply(v, n, x.data(), n + 1, vx.data());
+    e[2 * n] = 1;
+
+    bool e_negative = Compare(vx.data(), vx.size(), e.data(), e.size()) > 0;
+    if ( e_negative ) {
+        SubtractFrom(vx.data(), vx.size(), e.data(), e.size());
+        e.swap(vx);
+    } else {
+        SubtractFrom(e.data(), e.size(), vx.data(), vx.size());
+    }
+
+    // Newton correction x * e / B^2n
+    const size_t ne = TrimmedLength(e.data(), e.size());
+    if ( ne > 0 ) {
+        ScratchLimbs xe(n + 1 + ne);
+        Multiply(x.data(), n + 1, e.data(), ne, xe.data());
+
+        if ( xe.size() > 2 * n ) {
+            const PeUint* correction   = xe.data() + 2 * n;
+            const size_t  n_correction = TrimmedLength(correction, xe.size() - 2 * n);
+
+            if ( e_negative ) {
+                SubtractFrom(x.data(), n + 1, correction, n_correction);
+            } else {
+                AddTo(x.data(), n + 1, correction, n_correction);
+            }
+        }
+    }
+
+    // Final correction so that v * x <= B^2n - 1 < v * (x + 1)
+    ScratchLimbs limit(2 * n + 1, kBase - 1), one(1, 1);
+    limit[2 * n] = 0;
+    Multiply(v, n, x.data(), n + 1, vx.data());
+
+    while ( Compare(vx.data(), vx.size(), limit.data(), limit.size()) > 0 ) {
+        SubtractFrom(x.data(), n + 1, one.data(), 1);
+        SubtractFrom(vx.data(), vx.size(), v, n);
+    }
+
+    for ( ;; ) {
+        AddTo(vx.data(), vx.size(), v, n);
+        if ( Compare(vx.data(), vx.size(), limit.data(), limit.size()) > 0 ) {
+            break;
+        }
+        AddTo(x.data(), n + 1, one.data(), 1);
+    }
+
+    std::copy(x.begin(), x.end(), inv);
+}
+} // namespace
+
+// Newton division. The divisor's reciprocal is computed once, then the
+// numerator is divided in blocks of nv limbs (i.e. long division in base
+// B^nv). Each quotient block comes from one multiplication by the reciprocal
+// and is at most two too small, which is fixed with a multiply and check.
+void DivideNewton(const PeUint* u, size_t nu, const PeUint* v, size_t nv, PeUint* q, PeUint* r)
+{
+    const size_t n = nv;
+
+    // Normalise as for Algorithm D
+    const PeUint d = kBase / (v[n - 1] + 1);
+    ScratchLimbs un(nu + 1), vn(n + 1);
+    MultiplySmall(u, nu, d, un.data());
+    MultiplySmall(v, n, d, vn.data()); // vn[n] is always zero
+
+    ScratchLimbs inv(n + 1);
+    Reciprocal(vn.data(), n, inv.data());
+
+    // Long division in base B^n, from the most significant block down.
+    // Each step divides t = rem * B^n + block (t < v * B^n) by v.
+    const size_t n_blocks = (un.size() + n - 1) / n;
+    ScratchLimbs quotient(n_blocks * n, 0);
+    ScratchLimbs t(2 * n + 1, 0), t_inv(3 * n + 1), q_b(n + 1), qv(2 * n + 1), one(1, 1);
+
+    for ( size_t block = n_blocks; block-- > 0; ) {
+        // t = rem * B^n + block, where rem is in the upper half of t
+        std::copy(t.begin(), t.begin() + n, t.begin() + n);
+        std::fill(t.begin(), t.begin() + n, 0);
+        for ( size_t i = 0; (i < n) && (block * n + i < un.size()); ++i ) {
+            t[i] = un[block * n + i];
+        }
+
+        // Quotient estimate q_b = floor(t * inv / B^2n)
+        Multiply(t.data(), 2 * n, inv.data(), n + 1, t_inv.data());
+        std::copy(t_inv.begin() + 2 * n, t_inv.end(), q_b.begin());
+
+        // rem = t - q_b * v, then correct the estimate
+        Multiply(q_b.data(), n + 1, vn.data(), n, qv.data());
+        SubtractFrom(t.data(), 2 * n + 1, qv.data(), 2 * n + 1);
+
+        while ( Compare(t.data(), 2 * n + 1, vn.data(), n) >= 0 ) {
+            SubtractFrom(t.data(), 2 * n + 1, vn.data(), n);
+            AddTo(q_b.data(), n + 1, one.data(), 1);
+        }
+
+        // The corrected block is below B^n so its top limb is zero
+        std::copy(q_b.begin(), q_b.begin() + n, quotient.begin() + block * n);
+    }
+
+    if ( q ) {
+        std::copy(quotient.begin(), quotient.begin() + (nu - nv + 1), q);
+    }
+
+    // The final remainder is in the lower half of t
+    if ( r ) {
+        DivideSmall(t.data(), n, d);
+        std::copy(t.begin(), t.begin() + n, r);
+    }
+}
+
+// Divide <u> (length nu) by <v> (length nv), choosing an algorithm based on
+// operand sizes.
+void Divide(const PeUint* u, size_t nu, const PeUint* v, size_t nv, PeUint* q, PeUint* r)
+{
+    if ( (nv >= kNewtonDivisionThreshold) && (nu - nv + 1 >= kNewtonDivisionThreshold) ) {
+        DivideNewton(u, nu, v, nv, q, r);
+    } else {
+        DivideKnuth(u, nu, v, nv, q, r);
+    }
+}
+
+// Test whether all <n> characters of <str> are ASCII digits
+bool AllDigits(const char* str, size_t n)
+{
+    size_t i = 0;
+
+#if defined(PE_LIMBS_SSE2)
+    // 16 characters at a time: flag anything below '0' or above '9'.
+    // The comparisons are signed, so bytes >= 0x80 also count as below '0'.
+    const __m128i zero = _mm_set1_epi8('0');
+    const __m128i nine = _mm_set1_epi8('9');
+
+    for ( ; i + 16 <= n; i += 16 ) {
+        __m128i chars   = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str + i));
+        __m128i invalid = _mm_or_si128(_mm_cmplt_epi8(chars, zero), _mm_cmpgt_epi8(chars, nine));
+
+        if ( _mm_movemask_epi8(invalid) ) {
+            return false;
+        }
+    }
+#endif
+
+    for ( ; i < n; ++i ) {
+        if ( (str[i] < '0') || (str[i] > '9') ) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Convert exactly kBasePower ASCII digits to a limb value
+PeUint ParseLimb(const char* str)
+{
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+    PeUint val = 0;
+    for ( size_t i = 0; i < kBasePower; ++i ) {
+        val = 10 * val + (PeUint)(str[i] - '0');
+    }
+
+    return val;
+#else
+    // Load all eight characters into one word (first digit in the lowest
+    // byte) and combine neighbouring digits pairwise: 1 digit -> 2 digits
+    // per lane, then 2 -> 4 and 4 -> 8 using two multiplications.
+    // See Lemire, D. (2018). "Quickly parsing eight digits".
+    std::uint64_t val;
+    std::memcpy(&val, str, sizeof(val));
+
+    val -= 0x3030303030303030ull;
+    val = (val * 10) + (val >> 8);
+    val = (((val & 0x000000FF000000FFull) * 0x000F424000000064ull) +
+           (((val >> 16) & 0x000000FF000000FFull) * 0x0000271000000001ull)) >>
+          32;
+
+    return (PeUint)(val & 0xFFFFFFFFull);
+#endif
+}
+
+// Write a limb value as exactly kBasePower zero padded ASCII digits,
+// two digits at a time from a lookup table
+void FormatLimb(PeUint limb, char* str)
+{
+    static const char kDigitPairs[] = "00010203040506070809"
+                                      "10111213141516171819"
+                                      "20212223242526272829"
+                                      "30313233343536373839"
+                                      "40414243444546474849"
+                                      "50515253545556575859"
+                                      "60616263646566676869"
+                                      "70717273747576777879"
+                                      "80818283848586878889"
+                                      "90919293949596979899";
+
+    PeUint hi = limb / 10000, lo = limb % 10000;
+
+    std::memcpy(str, &kDigitPairs[2 * (hi / 100)], 2);
+    std::memcpy(str + 2, &kDigitPairs[2 * (hi % 100)], 2);
+    std::memcpy(str + 4, &kDigitPairs[2 * (lo / 100)], 2);
+    std::memcpy(str + 6, &kDigitPairs[2 * (lo % 100)], 2);
+}
+}; // namespace limbs
+}; // namespace pe
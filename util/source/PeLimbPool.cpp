@@ -0,0 +1,199 @@
+// Copyright 2020-2023 Paul Robertson
+//
+// PeLimbPool.cpp
+//
+// Recycling of heap blocks for big integer limb storage
+
+#include "PeLimbPool.h"
+
+#include <cstdlib>
+#include <new>
+
+namespace pe
+{
+namespace
+{
+// Per thread pool state. These are trivially destructible so remain usable
+// while other thread local objects are being destroyed.
+enum DefaultPoolState
+{
+    kDefaultPoolNotCreated,
+    kDefaultPoolAlive,
+    kDefaultPoolDestroyed
+};
+
+thread_local PeLimbPool*      tl_scope_pool         = nullptr;
+thread_local DefaultPoolState tl_default_pool_state = kDefaultPoolNotCreated;
+
+// The thread's default pool, which records its own lifetime so that blocks
+// freed after it's gone (e.g. by static PeBigInts) go straight to the heap
+struct DefaultPool
+{
+    DefaultPool()
+    {
+        tl_default_pool_state = kDefaultPoolAlive;
+    }
+
+    ~DefaultPool()
+    {
+        tl_default_pool_state = kDefaultPoolDestroyed;
+    }
+
+    PeLimbPool pool;
+};
+
+PeLimbPool& DefaultLimbPool()
+{
+    thread_local DefaultPool default_pool;
+    return default_pool.pool;
+}
+
+// Size class of a request, i.e. the exponent of the smallest power of two
+// block (of at least 2^kMinClass bytes) holding <bytes>
+size_t SizeClass(size_t bytes, size_t min_class)
+{
+    size_t size_class = min_class;
+    while ( (size_t(1) << size_class) < bytes ) {
+        ++size_class;
+    }
+
+    return size_class;
+}
+} // namespace
+
+PeLimbPool::PeLimbPool(size_t max_cached_bytes) : cached_bytes_(0), max_cached_bytes_(max_cached_bytes) {}
+
+PeLimbPool::~PeLimbPool()
+{
+    release();
+}
+
+// Allocate a block, rounding the size up to its class
+void* PeLimbPool::allocate(size_t& bytes)
+{
+    const size_t size_class = SizeClass(bytes, kMinClass);
+
+    // Oversized blocks aren't pooled
+    if ( size_class > kMaxClass ) {
+        void* block = std::malloc(bytes);
+        if ( !block ) {
+            throw std::bad_alloc();
+        }
+
+        return block;
+    }
+
+    bytes = size_t(1) << size_class;
+
+    // Reuse a cached block if there is one
+    std::vector<void*>& free_list = free_blocks_[size_class];
+    if ( !free_list.empty() ) {
+        void* block = free_list.back();
+        free_list.pop_back();
+        cached_bytes_ -= bytes;
+
+        return block;
+    }
+
+    void* block = std::malloc(bytes);
+    if ( !block ) {
+        throw std::bad_alloc();
+    }
+
+    return block;
+}
+
+// Cache a block for reuse. Only exact class sizes are cached, since those
+// are the only sizes allocate() hands out for pooled blocks.
+void PeLimbPool::deallocate(void* block, size_t bytes)
+{
+    const size_t size_class = SizeClass(bytes, kMinClass);
+
+    if ( (size_class <= kMaxClass) && ((size_t(1) << size_class) == bytes) &&
+         (free_blocks_[size_class].size() < kMaxBlocksPerClass) && (bytes <= max_cached_bytes_ - cached_bytes_) ) {
+        free_blocks_[size_class].push_back(block);
+        cached_bytes_ += bytes;
+    } else {
+        std::free(block);
+    }
+}
+
+void PeLimbPool::release()
+{
+    trim(0);
+}
+
+void PeLimbPool::trim(size_t max_bytes)
+{
+    for ( size_t size_class = kMaxClass + 1; (size_class-- > kMinClass) && (cached_bytes_ > max_bytes); ) {
+        std::vector<void*>& free_list = free_blocks_[size_class];
+
+        while ( !free_list.empty() && (cached_bytes_ > max_bytes) ) {
+            std::free(free_list.back());
+            free_list.pop_back();
+            cached_bytes_ -= size_t(1) << size_class;
+        }
+    }
+}
+
+size_t PeLimbPool::cachedBytes() const
+{
+    return cached_bytes_;
+}
+
+size_t PeLimbPool::maxCachedBytes() const
+{
+    return max_cached_bytes_;
+}
+
+void PeLimbPool::setMaxCachedBytes(size_t max_cached_bytes)
+{
+    max_cached_bytes_ = max_cached_bytes;
+    trim(max_cached_bytes);
+}
+
+PeLimbPool& PeLimbPool::current()
+{
+    return tl_scope_pool ? *tl_scope_pool : DefaultLimbPool();
+}
+
+void* PeLimbPool::allocateCurrent(size_t& bytes)
+{
+    if ( !tl_scope_pool && (tl_default_pool_state == kDefaultPoolDestroyed) ) {
+        void* block = std::malloc(bytes);
+        if ( !block ) {
+            throw std::bad_alloc();
+        }
+
+        return block;
+    }
+
+    return current().allocate(bytes);
+}
+
+void PeLimbPool::deallocateCurrent(void* block, size_t bytes)
+{
+    if ( !tl_scope_pool && (tl_default_pool_state == kDefaultPoolDestroyed) ) {
+        std::free(block);
+    } else {
+        current().deallocate(block, bytes);
+    }
+}
+
+// Scopes form a stack through their previous_ pointers
+PeLimbPoolScope::PeLimbPoolScope(size_t max_cached_bytes) : pool_(max_cached_bytes), previous_(tl_scope_pool)
+{
+    tl_scope_pool = &pool_;
+}
+
+PeLimbPoolScope::~PeLimbPoolScope()
+{
+    tl_scope_pool = previous_;
+}
+
+PeLimbPool& PeLimbPoolScope::pool()
+{
+    return pool_;
+}
+
+} // namespace pe
@@ -0,0 +1,333 @@
+// Copyright 2020-2023 Paul Robertson
+//
+// PePrimality.cpp
+//
+// Deterministic primality testing for 64 bit integers
+
+#include "PePrimality.h"
+#include "PeIntrinsics.h"
+
+#include <algorithm>
+
+namespace pe
+{
+namespace math
+{
+namespace
+{
+// Trial division is by the odd primes up to 97, so anything left below
+// 101^2 is prime
+const size_t kTrialPrimeCount              = 24;
+const PeUint kTrialPrimes[kTrialPrimeCount] = { 3,  5,  7,  11, 13, 17, 19, 23, 29, 31, 37, 41,
+                                                43, 47, 53, 59, 61, 67, 71, 73, 79, 83, 89, 97 };
+const PeUint kTrialPrimeLimit              = 101 * 101;
+
+// Bases for which the Miller-Rabin test is exact: 2, 7 and 61 for every
+// n < 4759123141 (Jaeschke), and these seven for every n < 2^64 (Sinclair)
+const PeUint kSmallBases[]        = { 2, 7, 61 };
+const PeUint kLargeBases[]        = { 2, 325, 9375, 28178, 450775, 9780504, 1795265022 };
+const PeUint kSmallBasesMaxNumber = 0xffffffffu;
+
+// For odd p, p divides n exactly when n * p^-1 (mod 2^64) is at most
+// (2^64 - 1) / p, since multiplying by p^-1 maps the multiples of p onto
+// [0, (2^64 - 1) / p]. That's a multiplication instead of a division.
+struct TrialDivisors
+{
+    PeUint inverse[kTrialPrimeCount];
+    PeUint limit[kTrialPrimeCount];
+};
+
+// p^-1 modulo 2^64 for odd p, by Newton's method. p is its own inverse
+// modulo 8, and each step doubles the number of correct bits.
+constexpr PeUint InverseModWord(PeUint p)
+{
+    PeUint inverse = p;
+    for ( int i = 0; i < 5; ++i ) {
+        inverse *= 2 - p * inverse;
+    }
+    return inverse;
+}
+
+constexpr TrialDivisors MakeTrialDivisors()
+{
+    TrialDivisors divisors{};
+    for ( size_t i = 0; i < kTrialPrimeCount; ++i ) {
+        divisors.inverse[i] = InverseModWord(kTrialPrimes[i]);
+        divisors.limit[i]   = ~PeUint(0) / kTrialPrimes[i];
+    }
+    return divisors;
+}
+
+constexpr TrialDivisors kTrialDivisors = MakeTrialDivisors();
+
+// What trial division found out about a number
+enum class TrialResult
+{
+    kPrime,
+    kComposite,
+    kUnknown
+};
+
+TrialResult TrialDivide(PeUint n)
+{
+    if ( n < 2 ) {
+        return TrialResult::kComposite;
+    }
+    if ( n % 2 == 0 ) {
+        return n == 2 ? TrialResult::kPrime : TrialResult::kComposite;
+    }
+
+    for ( size_t i = 0; i < kTrialPrimeCount; ++i ) {
+        if ( n * kTrialDivisors.inverse[i] <= kTrialDivisors.limit[i] ) {
+            return n == kTrialPrimes[i] ? TrialResult::kPrime : TrialResult::kComposite;
+        }
+    }
+
+    return n < kTrialPrimeLimit ? TrialResult::kPrime : TrialResult::kUnknown;
+}
+
+// All ones if <condition> holds, else zero. The choices inside the
+// Montgomery arithmetic and the batch loop are made by masking, as which
+// way they go is random, so a branch would be mispredicted half the time.
+inline PeUint Mask(bool condition)
+{
+    return 0 - (PeUint)condition;
+}
+
+// Arithmetic modulo an odd n, on numbers in Montgomery form: x stands for
+// x * 2^-64 (mod n), so 2^64 mod n stands for 1. Multiplying two of these
+// needs a reduction by 2^64 rather than by n, which is two multiplications
+// and a subtraction.
+struct Montgomery
+{
+    Montgomery() : n(0), inverse(0), one(0), minus_one(0), square(0) {}
+
+    explicit Montgomery(PeUint modulus) :
+        n(modulus), inverse(InverseModWord(modulus)), one((0 - modulus) % modulus), minus_one(modulus - one)
+    {
+        // 2^128 mod n, for converting into Montgomery form
+        intrinsics::DivWide(one, 0, n, square);
+    }
+
+    // a * b * 2^-64 (mod n). The low words of a * b and m * n match, so
+    // their difference is just the difference of the high words, which
+    // lies in (-n, n) for a, b < n.
+    PeUint multiply(PeUint a, PeUint b) const
+    {
+        PeUint       hi     = 0;
+        const PeUint lo     = intrinsics::MulWide(a, b, hi);
+        PeUint       m_n_hi = 0;
+        const PeUint m      = lo * inverse;
+        intrinsics::MulWide(m, n, m_n_hi);
+
+        return hi - m_n_hi + (n & Mask(hi < m_n_hi));
+    }
+
+    // 2 * a (mod n), which for base 2 replaces the multiplication by the
+    // base in Miller-Rabin
+    PeUint twice(PeUint a) const
+    {
+        const PeUint gap = n - a;
+        return a - gap + (n & Mask(a < gap));
+    }
+
+    PeUint toMontgomery(PeUint a) const
+    {
+        return multiply(a % n, square);
+    }
+
+    PeUint n;
+    PeUint inverse; // n^-1 (mod 2^64)
+    PeUint one;
+    PeUint minus_one;
+    PeUint square; // 2^128 (mod n)
+};
+
+// Bits in x, which must be non-zero
+int BitLength(PeUint x)
+{
+    return 64 - intrinsics::CountLeadingZeros(x);
+}
+
+// The Miller-Rabin test of odd n > 2 for one base. With n - 1 = d * 2^s
+// and d odd, n passes if base^d = 1, or base^(d * 2^r) = -1 for some
+// r < s. Bases that are multiples of n tell us nothing, so pass.
+bool StrongProbablePrime(const Montgomery& mont, PeUint base, PeUint d, int s)
+{
+    const PeUint a = mont.toMontgomery(base);
+    if ( a == 0 ) {
+        return true;
+    }
+
+    // Left to right binary exponentiation
+    PeUint x = a;
+    for ( int bit = BitLength(d) - 2; bit >= 0; --bit ) {
+        x = mont.multiply(x, x);
+        if ( (d >> bit) & 1 ) {
+            x = (base == 2) ? mont.twice(x) : mont.multiply(x, a);
+        }
+    }
+
+    if ( (x == mont.one) || (x == mont.minus_one) ) {
+        return true;
+    }
+    for ( int r = 1; r < s; ++r ) {
+        x = mont.multiply(x, x);
+        if ( x == mont.minus_one ) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// The bases needed for n
+void MillerRabinBases(PeUint n, const PeUint*& bases, size_t& n_bases)
+{
+    if ( n <= kSmallBasesMaxNumber ) {
+        bases   = kSmallBases;
+        n_bases = sizeof(kSmallBases) / sizeof(kSmallBases[0]);
+    } else {
+        bases   = kLargeBases;
+        n_bases = sizeof(kLargeBases) / sizeof(kLargeBases[0]);
+    }
+}
+} // namespace
+
+bool IsPrime(PeUint n)
+{
+    const TrialResult trial = TrialDivide(n);
+    if ( trial != TrialResult::kUnknown ) {
+        return trial == TrialResult::kPrime;
+    }
+
+    const Montgomery mont(n);
+    const int        s = intrinsics::CountTrailingZeros(n - 1);
+    const PeUint     d = (n - 1) >> s;
+
+    const PeUint* bases   = nullptr;
+    size_t        n_bases = 0;
+    MillerRabinBases(n, bases, n_bases);
+    for ( size_t i = 0; i < n_bases; ++i ) {
+        if ( !StrongProbablePrime(mont, bases[i], d, s) ) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Batch testing
+
+namespace
+{
+// Numbers tested together. Each Montgomery multiplication is a chain of
+// dependent multiplications, so a few independent chains fit in the gaps.
+const size_t kPrimeBatchLanes = 4;
+
+// One number's Miller-Rabin test in progress
+struct MillerRabinLane
+{
+    size_t        index; // In the caller's arrays
+    Montgomery    mont;
+    PeUint        d;
+    int           s;
+    const PeUint* bases;
+    size_t        n_bases;
+    size_t        next_base;
+};
+
+// Test each lane for its next base, returning whether each passed. Lanes
+// share the exponentiation loop, with the shorter exponents padded at the
+// top by squaring 1, and the multiplications by the base done by
+// multiplying by 1 for the zero bits. The loop always runs every lane,
+// spare lanes repeating the first, so that it unrolls with each lane's
+// state in registers.
+void MillerRabinRound(const MillerRabinLane* lanes, size_t n_lanes, bool* passed)
+{
+    Montgomery mont[kPrimeBatchLanes];
+    PeUint     d[kPrimeBatchLanes];
+    PeUint     a[kPrimeBatchLanes];
+    PeUint     x[kPrimeBatchLanes];
+    int        max_bits = 0;
+
+    for ( size_t k = 0; k < kPrimeBatchLanes; ++k ) {
+        const MillerRabinLane& lane = lanes[k < n_lanes ? k : 0];
+        mont[k]                     = lane.mont;
+        d[k]                        = lane.d;
+        a[k]                        = lane.mont.toMontgomery(lane.bases[lane.next_base]);
+        x[k]                        = lane.mont.one;
+        max_bits                    = std::max(max_bits, BitLength(lane.d));
+
+        // A base that's a multiple of n tells us nothing, so make it pass
+        if ( a[k] == 0 ) {
+            a[k] = lane.mont.one;
+        }
+    }
+
+    for ( int bit = max_bits - 1; bit >= 0; --bit ) {
+        for ( size_t k = 0; k < kPrimeBatchLanes; ++k ) {
+            const PeUint factor = mont[k].one ^ ((a[k] ^ mont[k].one) & Mask((d[k] >> bit) & 1));
+            x[k]                = mont[k].multiply(mont[k].multiply(x[k], x[k]), factor);
+        }
+    }
+
+    for ( size_t k = 0; k < n_lanes; ++k ) {
+        bool pass = (x[k] == mont[k].one) || (x[k] == mont[k].minus_one);
+        for ( int r = 1; !pass && (r < lanes[k].s); ++r ) {
+            x[k] = mont[k].multiply(x[k], x[k]);
+            pass = x[k] == mont[k].minus_one;
+        }
+        passed[k] = pass;
+    }
+}
+} // namespace
+
+// The numbers that trial division can't settle are tested in up to
+// kPrimeBatchLanes lanes, a base per round. A lane is refilled with the
+// next number as soon as its number fails a base or passes them all, so
+// the lanes stay full whatever mix of primes and composites comes in.
+void IsPrimeBatch(const PeUint* numbers, size_t count, bool* is_prime)
+{
+    MillerRabinLane lanes[kPrimeBatchLanes];
+    size_t          n_lanes = 0;
+    size_t          i       = 0;
+
+    while ( true ) {
+        while ( (n_lanes < kPrimeBatchLanes) && (i < count) ) {
+            const PeUint      n     = numbers[i];
+            const TrialResult trial = TrialDivide(n);
+            if ( trial != TrialResult::kUnknown ) {
+                is_prime[i++] = trial == TrialResult::kPrime;
+                continue;
+            }
+
+            MillerRabinLane& lane = lanes[n_lanes++];
+            lane.index            = i++;
+            lane.mont             = Montgomery(n);
+            lane.s                = intrinsics::CountTrailingZeros(n - 1);
+            lane.d                = (n - 1) >> lane.s;
+            lane.next_base        = 0;
+            MillerRabinBases(n, lane.bases, lane.n_bases);
+        }
+        if ( n_lanes == 0 ) {
+            break;
+        }
+
+        bool passed[kPrimeBatchLanes];
+        MillerRabinRound(lanes, n_lanes, passed);
+
+        // Retire the finished lanes, moving the last lane into each gap
+        for ( size_t k = n_lanes; k-- > 0; ) {
+            MillerRabinLane& lane = lanes[k];
+            if ( passed[k] && (++lane.next_base < lane.n_bases) ) {
+                continue;
+            }
+            is_prime[lane.index] = passed[k];
+            lane                 = lanes[--n_lanes];
+        }
+    }
+}
+}; // namespace math
+
+} // namespace pe
@@ -0,0 +1,424 @@
+// Copyright 2020-2023 Paul Robertson
+//
+// PePrimeCount.cpp
+//
+// Counting and summing primes without listing them
+
+#include "PePrimeCount.h"
+#include "PeIntrinsics.h"
+#include "PePrimeSieve.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace pe
+{
+namespace math
+{
+namespace
+{
+// phi(x, a) for the first few primes comes from tables over one period of
+// their product
+const PeUint kPhiSmallPrimes[] = { 2, 3, 5, 7, 11, 13 };
+const size_t kPhiSmallCount    = 6;
+const PeUint kPhiPeriod        = 2 * 3 * 5 * 7 * 11 * 13;
+
+// Nearly all the calls to phi() are for small x and a, so phi(x, a) for
+// x < kPhiCacheLimit and the first kPhiCachePrimes primes is tabulated
+// first. These values fit in 32 bits, even for sums.
+const PeUint kPhiCacheLimit  = PeUint(1) << 16;
+const size_t kPhiCachePrimes = 100;
+
+// The number and sum of the m in [1, r] coprime to kPhiPeriod, for each
+// r < kPhiPeriod
+struct PhiPeriodTable
+{
+    std::vector<PeUint> count;
+    std::vector<PeUint> sum;
+};
+
+const PhiPeriodTable& PhiPeriod()
+{
+    static const PhiPeriodTable table = [] {
+        PhiPeriodTable period;
+        period.count.resize(kPhiPeriod);
+        period.sum.resize(kPhiPeriod);
+
+        PeUint count = 0, sum = 0;
+        for ( PeUint m = 1; m < kPhiPeriod; ++m ) {
+            bool coprime = true;
+            for ( PeUint q: kPhiSmallPrimes ) {
+                coprime = coprime && (m % q != 0);
+            }
+            if ( coprime ) {
+                ++count;
+                sum += m;
+            }
+            period.count[m] = count;
+            period.sum[m]   = sum;
+        }
+        return period;
+    }();
+
+    return table;
+}
+
+// Weights for counting and summing, where f(m) is 1 or m. S(v) for the
+// n / k needs a Value, but S(v) for v up to 2^32 fits in 64 bits either
+// way, so those are PeUint.
+struct PrimeCountWeights
+{
+    typedef PeUint Value;
+
+    static PeUint Weight(PeUint)
+    {
+        return 1;
+    }
+
+    // Total weight of [2, v], for v >= 1
+    static Value Initial(PeUint v)
+    {
+        return v - 1;
+    }
+
+    static PeUint InitialSmall(PeUint v)
+    {
+        return v - 1;
+    }
+
+    // Total weight of the odd numbers base + 2 * j, for the set bits j
+    static PeUint BitsWeight(PeUint bits, PeUint)
+    {
+        return intrinsics::PopCount(bits);
+    }
+
+    // Total weight of the m in [1, x] with none of the kPhiSmallPrimes as
+    // a factor
+    static Value PhiSmall(PeUint x)
+    {
+        const PhiPeriodTable& period = PhiPeriod();
+        return x / kPhiPeriod * period.count[kPhiPeriod - 1] + period.count[x % kPhiPeriod];
+    }
+};
+
+struct PrimeSumWeights
+{
+    typedef PeUint128 Value;
+
+    static PeUint Weight(PeUint m)
+    {
+        return m;
+    }
+
+    // v * (v + 1) / 2 - 1, halving whichever of v and v + 1 is even
+    static Value Initial(PeUint v)
+    {
+        const Value sum = (v % 2 == 0) ? Value(v / 2) * Value(v + 1) : Value(v) * Value(v / 2 + 1);
+        return sum - Value(1);
+    }
+
+    static PeUint InitialSmall(PeUint v)
+    {
+        return v * (v + 1) / 2 - 1;
+    }
+
+    static PeUint BitsWeight(PeUint bits, PeUint base)
+    {
+        PeUint total = intrinsics::PopCount(bits) * base;
+        for ( ; bits != 0; bits &= bits - 1 ) {
+            total += 2 * (PeUint)intrinsics::CountTrailingZeros(bits);
+        }
+        return total;
+    }
+
+    // Writing x = q * kPhiPeriod + r, the coprime m are j * kPhiPeriod + s
+    // for j < q and each coprime s in the period, then q * kPhiPeriod + s
+    // for the coprime s up to r
+    static Value PhiSmall(PeUint x)
+    {
+        const PhiPeriodTable& period = PhiPeriod();
+        const PeUint          q      = x / kPhiPeriod;
+        const PeUint          r      = x % kPhiPeriod;
+
+        // q * (q - 1) / 2, halving whichever is even
+        const Value pairs = (q % 2 == 0) ? Value(q / 2) * Value(q - 1) : Value(q) * Value((q - 1) / 2);
+
+        return Value(q) * Value(period.sum[kPhiPeriod - 1])
+               + pairs * Value(kPhiPeriod * period.count[kPhiPeriod - 1])
+               + Value(q * kPhiPeriod) * Value(period.count[r]) + Value(period.sum[r]);
+    }
+};
+
+// Lucy_Hedgehog's method. S(v) for v up to sqrt(n) is held by v, and for
+// the larger n / k by k. For each prime, the large values are updated
+// first, from the smallest k, so that S(v / p) is read before it changes.
+template <typename Weights>
+typename Weights::Value PrimeWeightLucy(PeUint n)
+{
+    typedef typename Weights::Value Value;
+
+    if ( n < 2 ) {
+        return Value(0);
+    }
+
+    const PeUint        root = FloorSqrt(n);
+    std::vector<PeUint> small(root + 1);
+    std::vector<Value>  large(root + 1);
+    for ( PeUint v = 1; v <= root; ++v ) {
+        small[v] = Weights::InitialSmall(v);
+    }
+    for ( PeUint k = 1; k <= root; ++k ) {
+        large[k] = Weights::Initial(n / k);
+    }
+
+    for ( PeUint p = 2; p <= root; ++p ) {
+        if ( small[p] == small[p - 1] ) {
+            continue; // Not prime
+        }
+
+        const PeUint below  = small[p - 1]; // S(p - 1)
+        const PeUint weight = Weights::Weight(p);
+        const PeUint square = p * p;
+
+        // n / (k * p) is at most sqrt(n) once k * p > sqrt(n)
+        const PeUint k_end   = std::min(root, n / square);
+        const PeUint k_split = std::min(k_end, root / p);
+        for ( PeUint k = 1; k <= k_split; ++k ) {
+            large[k] -= Value(weight) * (large[k * p] - Value(below));
+        }
+        for ( PeUint k = k_split + 1; k <= k_end; ++k ) {
+            large[k] -= Value(weight) * Value(small[n / (k * p)] - below);
+        }
+
+        for ( PeUint v = root; v >= square; --v ) {
+            small[v] -= weight * (small[v / p] - below);
+        }
+    }
+
+    return large[1];
+}
+
+// S(v) for every v up to a limit, from one bit per odd number and the
+// total weight of the primes before each word of 64 bits
+template <typename Weights>
+class PrimeWeightTable
+{
+public:
+    typedef typename Weights::Value Value;
+
+    explicit PrimeWeightTable(PeUint limit) : entries_(limit / 128 + 1)
+    {
+        const std::vector<PeUint> seeds = PeSegmentedSieve::SievingPrimes(limit);
+        PeSegmentedSieve          sieve(3, limit, seeds);
+        while ( sieve.next() ) {
+            sieve.forEachPrime([this](PeUint p) {
+                const PeUint i = (p - 1) / 2;
+                entries_[i / 64].bits |= PeUint(1) << (i % 64);
+            });
+        }
+
+        Value below(Weights::Weight(2));
+        for ( size_t i_word = 0; i_word < entries_.size(); ++i_word ) {
+            entries_[i_word].below = below;
+            below += Value(Weights::BitsWeight(entries_[i_word].bits, 128 * i_word + 1));
+        }
+    }
+
+    Value operator()(PeUint v) const
+    {
+        if ( v < 2 ) {
+            return Value(0);
+        }
+
+        // The odd numbers up to v are bits 0 to i
+        const PeUint i     = (v - 1) / 2;
+        const Entry& entry = entries_[i / 64];
+        const PeUint bits  = entry.bits & (~PeUint(0) >> (63 - i % 64));
+
+        return entry.below + Value(Weights::BitsWeight(bits, i / 64 * 128 + 1));
+    }
+
+private:
+    struct Entry
+    {
+        PeUint bits;
+        Value  below;
+    };
+
+    std::vector<Entry> entries_;
+}; // class PrimeWeightTable
+
+// The Meissel-Lehmer method, with a = pi(cbrt(n)). phi(x, a), the total
+// weight of the m in [1, x] with none of the first a primes as a factor,
+// counts 1, the primes in (p_a, x] and the products of two or more of the
+// primes above p_a. Products of three of those exceed n, so
+//
+//  S(n) = phi(n, a) - 1 + S(p_a) - P2
+//
+// where P2 is the weight of the products p * q, p_a < p <= q. Each p
+// contributes f(p) * (S(n / p) - S(p - 1)), and n / p < n^(2/3), so a
+// table of S(v) up to there gives P2, and also finishes off phi() early.
+template <typename Weights>
+class MeisselLehmer
+{
+public:
+    typedef typename Weights::Value Value;
+
+    MeisselLehmer(const std::vector<PeUint>& primes, const std::vector<Value>& prefix,
+                  const PrimeWeightTable<Weights>& table, PeUint table_limit, size_t a) :
+        primes_(primes), prefix_(prefix), table_(table), table_limit_(table_limit)
+    {
+        // Row a - kPhiSmallCount holds phi(x, a). The first row adds up the
+        // x coprime to kPhiPeriod, and each row after comes from the last.
+        cache_rows_ = std::min(a, kPhiCachePrimes) + 1 - kPhiSmallCount;
+        cache_.resize(cache_rows_ * kPhiCacheLimit);
+
+        const PhiPeriodTable& period = PhiPeriod();
+        PeUint                total  = 0;
+        for ( PeUint x = 1; x < kPhiCacheLimit; ++x ) {
+            const PeUint r = x % kPhiPeriod;
+            if ( (r != 0) && (period.count[r] != period.count[r - 1]) ) {
+                total += Weights::Weight(x);
+            }
+            cache_[x] = (std::uint32_t)total;
+        }
+
+        for ( size_t row = 1; row < cache_rows_; ++row ) {
+            const PeUint         p        = primes_[kPhiSmallCount + row - 1];
+            const PeUint         weight   = Weights::Weight(p);
+            const std::uint32_t* previous = &cache_[(row - 1) * kPhiCacheLimit];
+            std::uint32_t*       current  = &cache_[row * kPhiCacheLimit];
+
+            // Runs of p values of x share x / p
+            for ( PeUint quotient = 0, x = 0; x < kPhiCacheLimit; ++quotient ) {
+                const std::uint32_t removed = (std::uint32_t)weight * previous[quotient];
+                for ( const PeUint run_end = std::min(x + p, kPhiCacheLimit); x < run_end; ++x ) {
+                    current[x] = previous[x] - removed;
+                }
+            }
+        }
+    }
+
+    // phi(x, a) = phi(x, a - 1) - f(p_a) * phi(x / p_a, a - 1), unrolled
+    // down to the small primes. Once x < p^2, phi(x / p, ...) is just 1
+    // for p and every larger prime.
+    Value phi(PeUint x, size_t a) const
+    {
+        const PeUint next = primes_[a];
+        if ( x < next ) {
+            return Value(x >= 1 ? 1 : 0);
+        }
+        if ( (x < kPhiCacheLimit) && (a < kPhiSmallCount + cache_rows_) ) {
+            return Value(cache_[(a - kPhiSmallCount) * kPhiCacheLimit + x]);
+        }
+        if ( (x <= table_limit_) && (x / next < next) ) {
+            return Value(1) + table_(x) - prefix_[a];
+        }
+
+        Value result = Weights::PhiSmall(x);
+        for ( size_t i = kPhiSmallCount; i < a; ++i ) {
+            const PeUint p        = primes_[i];
+            const PeUint quotient = x / p;
+            if ( quotient < p ) {
+                result -= prefix_[a] - prefix_[i];
+                break;
+            }
+            result -= Value(Weights::Weight(p)) * phi(quotient, i);
+        }
+
+        return result;
+    }
+
+private:
+    const std::vector<PeUint>&       primes_;
+    const std::vector<Value>&        prefix_; // prefix_[a] = S(p_a), the first a primes
+    const PrimeWeightTable<Weights>& table_;
+    PeUint                           table_limit_;
+    std::vector<std::uint32_t>       cache_;
+    size_t                           cache_rows_;
+}; // class MeisselLehmer
+
+// floor(cbrt(n)), correcting the floating point estimate
+PeUint FloorCbrt(PeUint n)
+{
+    const PeUint kMaxCbrt = 2642245; // Any larger has a cube beyond 2^64
+
+    PeUint root = std::min((PeUint)std::cbrt((double)n), kMaxCbrt);
+    while ( root * root * root > n ) {
+        --root;
+    }
+    while ( (root < kMaxCbrt) && ((root + 1) * (root + 1) * (root + 1) <= n) ) {
+        ++root;
+    }
+
+    return root;
+}
+
+template <typename Weights>
+typename Weights::Value PrimeWeightMeissel(PeUint n)
+{
+    typedef typename Weights::Value Value;
+
+    // Small enough that the tables would be most of the work
+    if ( n < kPhiPeriod ) {
+        return PrimeWeightLucy<Weights>(n);
+    }
+
+    // The primes up to sqrt(n), and their running weights
+    std::vector<PeUint> primes = PeSegmentedSieve::SievingPrimes(n);
+    primes.insert(primes.begin(), 2);
+
+    std::vector<Value> prefix(primes.size() + 1);
+    for ( size_t i = 0; i < primes.size(); ++i ) {
+        prefix[i + 1] = prefix[i] + Value(Weights::Weight(primes[i]));
+    }
+
+    const size_t a           = std::upper_bound(primes.begin(), primes.end(), FloorCbrt(n)) - primes.begin();
+    const PeUint table_limit = n / primes[a];
+
+    const PrimeWeightTable<Weights> table(table_limit);
+    const MeisselLehmer<Weights>    meissel(primes, prefix, table, table_limit, a);
+
+    Value p2(0);
+    for ( size_t i = a; i < primes.size(); ++i ) {
+        p2 += Value(Weights::Weight(primes[i])) * (table(n / primes[i]) - prefix[i]);
+    }
+
+    return meissel.phi(n, a) - Value(1) + prefix[a] - p2;
+}
+} // namespace
+
+PeUint PrimePi(PeUint n)
+{
+    return n < kPrimeCountMeisselThreshold ? PrimePiLucy(n) : PrimePiMeissel(n);
+}
+
+PeUint128 PrimeSum(PeUint n)
+{
+    return n < kPrimeCountMeisselThreshold ? PrimeSumLucy(n) : PrimeSumMeissel(n);
+}
+
+PeUint PrimePiLucy(PeUint n)
+{
+    return PrimeWeightLucy<PrimeCountWeights>(n);
+}
+
+PeUint128 PrimeSumLucy(PeUint n)
+{
+    return PrimeWeightLucy<PrimeSumWeights>(n);
+}
+
+PeUint PrimePiMeissel(PeUint n)
+{
+    return PrimeWeightMeissel<PrimeCountWeights>(n);
+}
+
+PeUint128 PrimeSumMeissel(PeUint n)
+{
+    return PrimeWeightMeissel<PrimeSumWeights>(n);
+}
+}; // namespace math
+
+} // namespace pe
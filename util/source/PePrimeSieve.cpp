@@ -0,0 +1,556 @@
+// Copyright 2020-2023 Paul Robertson
+//
+// PePrimeSieve.cpp
+//
+// Segmented Sieve of Eratosthenes over the odd numbers
+
+#include "PePrimeSieve.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <exception>
+#include <functional>
+#include <future>
+#include <numeric>
+#include <thread>
+
+namespace pe
+{
+// The primes crossed off by the presieve pattern, and the pattern's period
+// in odd numbers (their product)
+const PeUint kPresievePrimes[]  = { 3, 5, 7, 11, 13 };
+const PeUint kLargestPresieved  = 13;
+const PeUint kPresievePeriod    = 3 * 5 * 7 * 11 * 13;
+const PeUint kMaxSievingPrime   = 0xffffffffu; // Any larger has a square beyond 2^64
+
+// Numbers covered by one segment of a sieve
+const PeUint kSegmentSpan = 16 * kSieveSegmentBytes;
+
+// floor(sqrt(n)), correcting the floating point estimate
+PeUint FloorSqrt(PeUint n)
+{
+    PeUint root = std::min((PeUint)std::sqrt((double)n), kMaxSievingPrime);
+    while ( root * root > n ) {
+        --root;
+    }
+    while ( (root < kMaxSievingPrime) && ((root + 1) * (root + 1) <= n) ) {
+        ++root;
+    }
+
+    return root;
+}
+
+namespace
+{
+// One period of odd numbers with the multiples of the presieve primes
+// cleared, bit i standing for 2 * i + 1. A word's worth of bits past the
+// period are repeated after it, so any 64 bits can be read from any start.
+const std::vector<PeUint>& PresievePattern()
+{
+    static const std::vector<PeUint> pattern = [] {
+        std::vector<PeUint> bits((kPresievePeriod + 64) / 64 + 1, 0);
+        for ( PeUint i = 0; i < 64 * bits.size(); ++i ) {
+            const PeUint n        = 2 * i + 1;
+            bool         coprime  = true;
+            for ( PeUint q: kPresievePrimes ) {
+                coprime = coprime && (n % q != 0);
+            }
+            if ( coprime ) {
+                bits[i / 64] |= PeUint(1) << (i % 64);
+            }
+        }
+        return bits;
+    }();
+
+    return pattern;
+}
+} // namespace
+
+// A plain sieve over the odd numbers up to sqrt(high), one byte each, or
+// for more than a segment's worth, a segmented sieve with its own sieving
+// primes (which keeps to the cache, where a byte per number wouldn't)
+std::vector<PeUint> PeSegmentedSieve::SievingPrimes(PeUint high)
+{
+    const PeUint        root = FloorSqrt(high);
+    std::vector<PeUint> primes;
+
+    if ( root < 3 ) {
+        return primes;
+    }
+
+    if ( root > kSegmentSpan ) {
+        const std::vector<PeUint> seeds = SievingPrimes(root);
+        PeSegmentedSieve          sieve(3, root, seeds);
+
+        // pi(x) <= x / (ln(x) - 1.1) for x >= 60184 (Dusart)
+        primes.reserve((size_t)((double)root / (std::log((double)root) - 1.1)));
+        while ( sieve.next() ) {
+            sieve.forEachPrime([&primes](PeUint p) { primes.push_back(p); });
+        }
+        return primes;
+    }
+
+    // Index i stands for 2 * i + 1
+    const PeUint               n_odd = (root - 1) / 2 + 1;
+    std::vector<unsigned char> is_composite(n_odd, 0);
+
+    for ( PeUint i = 1; i < n_odd; ++i ) {
+        if ( is_composite[i] ) {
+            continue;
+        }
+
+        const PeUint p = 2 * i + 1;
+        primes.push_back(p);
+
+        // Odd multiples from p^2, 2p apart
+        for ( PeUint j = (p * p - 1) / 2; j < n_odd; j += p ) {
+            is_composite[j] = 1;
+        }
+    }
+
+    return primes;
+}
+
+PeSegmentedSieve::PeSegmentedSieve(PeUint low, PeUint high, const std::vector<PeUint>& seeds, size_t segment_bytes) :
+    seeds_(&seeds),
+    first_seed_(0),
+    words_(std::max<size_t>(segment_bytes / sizeof(PeUint), 1), 0),
+    n_words_(0),
+    segment_index_(low / 2),
+    segment_end_(low / 2),
+    begin_index_(low / 2),
+    end_index_(high / 2 + (high & 1)) // The odd numbers up to high
+{
+}
+
+bool PeSegmentedSieve::next()
+{
+    segment_index_ = segment_end_;
+    if ( segment_index_ >= end_index_ ) {
+        n_words_ = 0;
+        return false;
+    }
+
+    const PeUint n_bits = std::min<PeUint>(64 * words_.size(), end_index_ - segment_index_);
+    segment_end_        = segment_index_ + n_bits;
+    n_words_            = (size_t)((n_bits + 63) / 64);
+
+    presieve();
+    crossOff(segment_end_);
+
+    // Clear the bits past the end of the range
+    if ( n_bits % 64 != 0 ) {
+        words_[n_words_ - 1] &= (PeUint(1) << (n_bits % 64)) - 1;
+    }
+
+    return true;
+}
+
+PeUint PeSegmentedSieve::low() const
+{
+    return 2 * begin_index_ + 1;
+}
+
+PeUint PeSegmentedSieve::high() const
+{
+    return 2 * (end_index_ - 1) + 1;
+}
+
+PeUint PeSegmentedSieve::segmentLow() const
+{
+    return 2 * segment_index_ + 1;
+}
+
+PeUint PeSegmentedSieve::segmentHigh() const
+{
+    return 2 * (segment_end_ - 1) + 1;
+}
+
+size_t PeSegmentedSieve::count() const
+{
+    size_t total = 0;
+    for ( size_t i_word = 0; i_word < n_words_; ++i_word ) {
+        total += intrinsics::PopCount(words_[i_word]);
+    }
+
+    return total;
+}
+
+// Each word is 64 bits of the pattern, starting from where the segment's
+// first index falls in the period
+void PeSegmentedSieve::presieve()
+{
+    const std::vector<PeUint>& pattern = PresievePattern();
+
+    PeUint offset = segment_index_ % kPresievePeriod;
+    for ( size_t i_word = 0; i_word < n_words_; ++i_word ) {
+        const PeUint word_index = offset / 64;
+        const PeUint shift      = offset % 64;
+
+        words_[i_word] = shift == 0 ? pattern[word_index]
+                                    : (pattern[word_index] >> shift) | (pattern[word_index + 1] << (64 - shift));
+
+        offset += 64;
+        if ( offset >= kPresievePeriod ) {
+            offset -= kPresievePeriod;
+        }
+    }
+
+    // The pattern crosses off the presieve primes themselves, and leaves 1
+    for ( PeUint q: kPresievePrimes ) {
+        const PeUint index = (q - 1) / 2;
+        if ( (index >= segment_index_) && (index < segment_end_) ) {
+            words_[(index - segment_index_) / 64] |= PeUint(1) << ((index - segment_index_) % 64);
+        }
+    }
+
+    if ( segment_index_ == 0 ) {
+        words_[0] &= ~PeUint(1);
+    }
+}
+
+// The odd multiples of p are p * (2k + 1), with index p * k + (p - 1) / 2,
+// so they're p apart in index. Each prime starts at p^2 (smaller multiples
+// have smaller factors), or in the first segment from the first multiple
+// in range.
+void PeSegmentedSieve::crossOff(PeUint end_index)
+{
+    const std::vector<PeUint>& seeds = *seeds_;
+
+    // Bring in the primes whose squares are now in range
+    while ( first_seed_ + next_multiple_.size() < seeds.size() ) {
+        const PeUint p = seeds[first_seed_ + next_multiple_.size()];
+
+        if ( next_multiple_.empty() && (p <= kLargestPresieved) ) {
+            ++first_seed_;
+            continue;
+        }
+
+        if ( (p > kMaxSievingPrime) || ((p - 1) / 2 * (p + 1) >= end_index) ) {
+            break;
+        }
+
+        const PeUint residue = (p - 1) / 2;
+        const PeUint offset  = segment_index_ % p;
+        const PeUint first   = segment_index_ + (residue >= offset ? residue - offset : residue + p - offset);
+
+        next_multiple_.push_back(std::max(first, (p - 1) / 2 * (p + 1)));
+    }
+
+    for ( size_t i_seed = 0; i_seed < next_multiple_.size(); ++i_seed ) {
+        const PeUint p = seeds[first_seed_ + i_seed];
+        PeUint       j = next_multiple_[i_seed];
+
+        for ( ; j < end_index; j += p ) {
+            const PeUint bit = j - segment_index_;
+            words_[bit / 64] &= ~(PeUint(1) << (bit % 64));
+        }
+
+        next_multiple_[i_seed] = j;
+    }
+}
+
+// Prime iteration
+
+// The end iterator's sieve has an empty range, so needs no real segment
+PePrimeIterator::PePrimeIterator() :
+    limit_(0),
+    done_(true),
+    seeds_(std::make_shared<const std::vector<PeUint>>()),
+    seed_root_(0),
+    sieve_(3, 2, *seeds_, sizeof(PeUint)),
+    sieved_to_(0),
+    position_(0)
+{
+}
+
+PePrimeIterator::PePrimeIterator(PeUint start, PeUint limit) : PePrimeIterator()
+{
+    limit_ = limit;
+    restart(start);
+}
+
+void PePrimeIterator::skipTo(PeUint n)
+{
+    if ( !done_ && (n >= buffer_[position_]) && (n <= sieved_to_) ) {
+        position_ = std::lower_bound(buffer_.begin() + position_, buffer_.end(), n) - buffer_.begin();
+        if ( position_ == buffer_.size() ) {
+            fill();
+        }
+        return;
+    }
+
+    restart(n);
+}
+
+// The sieve only covers odd numbers, so 2 is buffered on its own
+void PePrimeIterator::restart(PeUint start)
+{
+    buffer_.clear();
+    position_ = 0;
+    done_     = (start > limit_) || (limit_ < 2);
+    if ( done_ ) {
+        return;
+    }
+
+    if ( start <= 2 ) {
+        buffer_.push_back(2);
+        sieved_to_ = 2;
+    } else {
+        sieved_to_ = start - 1;
+    }
+
+    startSieve();
+    if ( buffer_.empty() ) {
+        fill();
+    }
+}
+
+// The sieving primes are found from scratch each time, so they're found
+// with an eighth to spare, which covers the next quarter or so of the
+// number line. A new sieve only brings in the sieving primes as it needs
+// them, so its setup is a division for each of those.
+void PePrimeIterator::startSieve()
+{
+    const PeUint root = FloorSqrt(nextHigh());
+    if ( root > seed_root_ ) {
+        seed_root_ = std::min(root + root / 8, FloorSqrt(limit_));
+        seeds_     = std::make_shared<const std::vector<PeUint>>(PeSegmentedSieve::SievingPrimes(seed_root_ * seed_root_));
+    }
+
+    sieve_ = PeSegmentedSieve(sieved_to_ + 1, limit_, *seeds_);
+}
+
+void PePrimeIterator::fill()
+{
+    buffer_.clear();
+    position_ = 0;
+
+    while ( buffer_.empty() ) {
+        if ( sieved_to_ >= limit_ ) {
+            done_ = true;
+            return;
+        }
+
+        if ( FloorSqrt(nextHigh()) > seed_root_ ) {
+            startSieve();
+        }
+
+        if ( !sieve_.next() ) {
+            done_ = true;
+            return;
+        }
+
+        sieved_to_ = sieve_.segmentHigh();
+        sieve_.forEachPrime([this](PeUint p) { buffer_.push_back(p); });
+    }
+}
+
+// Segments are 8 * kSieveSegmentBytes odd numbers from the first one after
+// sieved_to_
+PeUint PePrimeIterator::nextHigh() const
+{
+    return limit_ - sieved_to_ > kSegmentSpan ? sieved_to_ + kSegmentSpan : limit_;
+}
+
+// Parallel sieving
+
+namespace math
+{
+// Each thread gets several chunks, so that threads finishing early can take
+// more, but each chunk is several segments, since a new sieve has to find
+// every sieving prime's first multiple
+const size_t kSieveChunksPerThread  = 8;
+const size_t kSieveSegmentsPerChunk = 4;
+
+namespace
+{
+// The number of threads to use, given a requested count (0 for all)
+size_t SieveThreads(size_t threads)
+{
+    return threads == 0 ? std::max<size_t>(std::thread::hardware_concurrency(), 1) : threads;
+}
+
+// Segments of a sieve over the odd numbers [3, limit]
+PeUint SieveSegments(PeUint limit)
+{
+    const PeUint segment_bits = 8 * kSieveSegmentBytes;
+    const PeUint end_index    = limit / 2 + (limit & 1);
+
+    return (end_index - 1 + segment_bits - 1) / segment_bits;
+}
+
+// The number of chunks to split [3, limit] into for <threads> threads
+size_t SieveChunkCount(PeUint limit, size_t threads)
+{
+    const PeUint chunks = std::min<PeUint>(SieveSegments(limit) / kSieveSegmentsPerChunk,
+                                           SieveThreads(threads) * kSieveChunksPerThread);
+
+    return (size_t)std::max<PeUint>(chunks, 1);
+}
+
+// Run work() on <workers> threads, including this one, returning once all
+// have finished. Exceptions (e.g. bad_alloc) are passed on once every
+// thread has finished.
+void RunSieveWorkers(size_t workers, const std::function<void()>& work)
+{
+    std::vector<std::future<void>> others;
+    for ( size_t worker = 1; worker < workers; ++worker ) {
+        others.push_back(std::async(std::launch::async, work));
+    }
+
+    std::exception_ptr error;
+    try {
+        work();
+    } catch ( ... ) {
+        error = std::current_exception();
+    }
+
+    for ( auto& other: others ) {
+        try {
+            other.get();
+        } catch ( ... ) {
+            if ( !error ) {
+                error = std::current_exception();
+            }
+        }
+    }
+
+    if ( error ) {
+        std::rethrow_exception(error);
+    }
+}
+
+// Run body(chunk) for chunk = 0 ... n_chunks - 1 on up to <threads>
+// threads, each taking the next chunk as it finishes the last
+void ForEachChunk(size_t n_chunks, size_t threads, const std::function<void(size_t)>& body)
+{
+    std::atomic<size_t> next_chunk(0);
+
+    RunSieveWorkers(std::min(SieveThreads(threads), n_chunks), [&] {
+        for ( size_t chunk = next_chunk++; chunk < n_chunks; chunk = next_chunk++ ) {
+            body(chunk);
+        }
+    });
+}
+
+// Split the odd numbers [3, limit] into <n_chunks> runs of whole segments
+// and call sieve_chunk(chunk, sieve) for each one, with a PeSegmentedSieve
+// over the chunk ready to have next() called
+void SieveChunks(PeUint limit, size_t threads, size_t n_chunks,
+                 const std::function<void(size_t, PeSegmentedSieve&)>& sieve_chunk)
+{
+    const std::vector<PeUint> seeds = PeSegmentedSieve::SievingPrimes(limit);
+
+    // Odd number indices [1, end_index), i.e. 3 to limit
+    const PeUint end_index  = limit / 2 + (limit & 1);
+    const PeUint chunk_bits = (SieveSegments(limit) + n_chunks - 1) / n_chunks * 8 * kSieveSegmentBytes;
+
+    ForEachChunk(n_chunks, threads, [&](size_t chunk) {
+        const PeUint first = 1 + chunk * chunk_bits;
+        if ( first >= end_index ) {
+            return;
+        }
+        const PeUint last = std::min(first + chunk_bits, end_index) - 1;
+
+        PeSegmentedSieve sieve(2 * first + 1, 2 * last + 1, seeds);
+        sieve_chunk(chunk, sieve);
+    });
+}
+
+// Roughly the number of primes in [low, high], for reserving space. This
+// is a little over the count for the chunks used here, and only needs to
+// be close, to save resizing.
+size_t EstimatePrimesBetween(PeUint low, PeUint high)
+{
+    const double log_high = std::log(std::max((double)high, 10.0));
+
+    return (size_t)((double)(high - low) / (log_high - 1.1) * 1.02) + 64;
+}
+} // namespace
+
+// Each chunk's primes go to their own array. Once the chunk sizes are
+// known, each chunk has its place in the result, so the copying is shared
+// between the threads too.
+std::vector<PeUint> GeneratePrimesParallel(PeUint limit, size_t threads)
+{
+    if ( limit < 3 ) {
+        return limit == 2 ? std::vector<PeUint>({ 2 }) : std::vector<PeUint>();
+    }
+
+    const size_t                     n_chunks = SieveChunkCount(limit, threads);
+    std::vector<std::vector<PeUint>> chunk_primes(n_chunks);
+
+    SieveChunks(limit, threads, n_chunks, [&](size_t chunk, PeSegmentedSieve& sieve) {
+        std::vector<PeUint>& primes = chunk_primes[chunk];
+        primes.reserve(EstimatePrimesBetween(sieve.low(), sieve.high()));
+        while ( sieve.next() ) {
+            sieve.forEachPrime([&primes](PeUint p) { primes.push_back(p); });
+        }
+    });
+
+    // Offsets of each chunk in the result, after 2
+    std::vector<size_t> offsets(n_chunks + 1, 1);
+    for ( size_t chunk = 0; chunk < n_chunks; ++chunk ) {
+        offsets[chunk + 1] = offsets[chunk] + chunk_primes[chunk].size();
+    }
+
+    std::vector<PeUint> primes_array(offsets[n_chunks]);
+    primes_array[0] = 2;
+
+    ForEachChunk(n_chunks, threads, [&](size_t chunk) {
+        std::copy(chunk_primes[chunk].begin(), chunk_primes[chunk].end(), primes_array.begin() + offsets[chunk]);
+        std::vector<PeUint>().swap(chunk_primes[chunk]); // Free as we go
+    });
+
+    return primes_array;
+}
+
+PeUint SieveCountPrimes(PeUint limit, size_t threads)
+{
+    if ( limit < 3 ) {
+        return limit == 2 ? 1 : 0;
+    }
+
+    const size_t        n_chunks = SieveChunkCount(limit, threads);
+    std::vector<PeUint> counts(n_chunks, 0);
+
+    SieveChunks(limit, threads, n_chunks, [&](size_t chunk, PeSegmentedSieve& sieve) {
+        while ( sieve.next() ) {
+            counts[chunk] += sieve.count();
+        }
+    });
+
+    return std::accumulate(counts.begin(), counts.end(), PeUint(1)); // Including 2
+}
+
+// Each chunk sums into a low word and counts the carries out of it, which
+// is cheaper than a 128 bit addition for every prime
+PeUint128 SieveSumPrimes(PeUint limit, size_t threads)
+{
+    if ( limit < 3 ) {
+        return PeUint128(limit == 2 ? 2 : 0);
+    }
+
+    const size_t           n_chunks = SieveChunkCount(limit, threads);
+    std::vector<PeUint128> sums(n_chunks);
+
+    SieveChunks(limit, threads, n_chunks, [&](size_t chunk, PeSegmentedSieve& sieve) {
+        PeUint low = 0, carries = 0;
+        while ( sieve.next() ) {
+            sieve.forEachPrime([&](PeUint p) {
+                low += p;
+                carries += low < p;
+            });
+        }
+
+        sums[chunk].limb(0) = low;
+        sums[chunk].limb(1) = carries;
+    });
+
+    return std::accumulate(sums.begin(), sums.end(), PeUint128(2)); // Including 2
+}
+}; // namespace math
+
+} // namespace pe
@@ -6,6 +6,8 @@
 
 #include "PeUtilities.h"
 
+#include "PePrimeSieve.h"
+
 namespace pe
 {
 namespace formatting
@@ -266,46 +268,15 @@ std::vector<PeUint> GeneratePrimesEratosthenes(PeUint limit)
         // Set up the primes array
         std::vector<PeUint> primes_array;
         primes_array.reserve(num_primes);
+        primes_array.push_back(2);
 
-        // Set up an array of flags
-        std::vector<bool> is_prime(limit + 1, true);
-        is_prime[0] = false;
-        is_prime[1] = false;
-
-        // Incrementally mark off numbers as
-        // not prime by counting up to the limit
-        // in multiples of primes i.e.
-        // starting at 2, mark off 4, 6, 8 etc...
-        // then starting at 3, mark off 3, 6, 9, 12...
-        // then starting at 5 (skip 4 because it's already been marked non-prime)
-        // then starting at 7 and so on
-        PeUint p  = 2;
-        PeUint p2 = 4;
-        PeUint j  = p2;
-
-        while ( p2 <= limit ) { // Only check to sqrt(limit)
-            j = p2;
-            primes_array.push_back(p);
-            // Mark off multiples of prime
-            while ( j <= limit ) {
-                is_prime[j] = false;
-                j += p;
-            }
-
-            // Find the next number still marked as prime
-            do {
-                ++p;
-            } while ( !is_prime[p] );
-
-            // Take square
-            p2 = p * p;
-        }
+        // Sieve the odd numbers one cache sized segment at a time,
+        // see PePrimeSieve.h
+        const std::vector<PeUint> seeds = PeSegmentedSieve::SievingPrimes(limit);
+        PeSegmentedSieve          sieve(3, limit, seeds);
 
-        // Find remaining primes greater than sqrt(limit)
-        for ( PeUint i = p; i <= limit; ++i ) {
-            if ( is_prime[i] ) {
-                primes_array.push_back(i);
-            }
+        while ( sieve.next() ) {
+            sieve.forEachPrime([&primes_array](PeUint p) { primes_array.push_back(p); });
         }
 
         return primes_array;